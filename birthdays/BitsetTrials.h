@@ -0,0 +1,181 @@
+#ifndef BITSETTRIALS_H
+#define BITSETTRIALS_H
+
+#include "Xoshiro256.h"
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Birthday trials without a table. A trial only needs to know which of
+ * Days days it has seen, so its state is a Days-bit set, and each step
+ * draws a day, checks its bit and sets it. A trial's count is the
+ * number of days drawn up to and including the first repeat, the same
+ * thing testCollision counts with a calendar.
+ *
+ * Lanes trials run side by side, stored lane-major so one step of four
+ * trials is a handful of AVX2 instructions: each lane has its own
+ * xoshiro256** state, and the day's bit is found by comparing its word
+ * index against every word of the set rather than indexing per lane.
+ * When a trial finishes, its lane starts on the next one, so no lane
+ * waits for the others.
+ *
+ * Trial i draws from the stream Xoshiro256(seed, i), exactly as next()
+ * would, so counts don't depend on the lanes or threads in use.
+ */
+template<int Days = 365, int Lanes = 32>
+class BitsetTrials {
+public:
+    BitsetTrials(uint64_t seed);
+    template<class Fn>
+    void run(long long lo, long long hi, Fn fn);
+
+private:
+    static_assert(Days > 0 && Days <= (1 << 26), "day has to fit the 32-bit multiply");
+    static_assert(Lanes % 4 == 0 && Lanes <= 32, "lanes come in fours, up to 32");
+
+    static const int Words = (Days + 63) / 64;
+
+    void start(int lane, long long trial);
+    uint32_t step();
+
+    uint64_t seed;
+    // lane l of every array belongs to the trial in lane l
+    alignas(32) uint64_t s[4][Lanes];
+    alignas(32) uint64_t seen[Words][Lanes];
+    alignas(32) uint64_t steps[Lanes];
+    long long trial[Lanes];
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<int Days, int Lanes>
+BitsetTrials<Days, Lanes>::BitsetTrials(uint64_t seed) {
+    this->seed = seed;
+}
+
+// runs trials [lo, hi), calling fn(trial, count) as each one finishes;
+// trials finish out of order
+template<int Days, int Lanes>
+template<class Fn>
+void BitsetTrials<Days, Lanes>::run(long long lo, long long hi, Fn fn) {
+    long long next = lo;
+    int active = 0;
+    for (int l = 0; l < Lanes; ++l) {
+        if (next < hi) {
+            start(l, next++);
+            ++active;
+        } else {
+            // an idle lane still steps, but nothing it draws is counted
+            start(l, -1);
+        }
+    }
+
+    while (active > 0) {
+        uint32_t hits = step();
+        while (hits != 0) {
+            int l = __builtin_ctz(hits);
+            hits &= hits - 1;
+            if (trial[l] >= 0) {
+                fn(trial[l], (int)steps[l]);
+                --active;
+            }
+            if (next < hi) {
+                start(l, next++);
+                ++active;
+            } else {
+                start(l, -1);
+            }
+        }
+    }
+}
+
+template<int Days, int Lanes>
+void BitsetTrials<Days, Lanes>::start(int lane, long long trial) {
+    this->trial[lane] = trial;
+    Xoshiro256 rng(seed, trial);
+    for (int i = 0; i < 4; ++i)
+        s[i][lane] = rng.state(i);
+    for (int w = 0; w < Words; ++w)
+        seen[w][lane] = 0;
+    steps[lane] = 0;
+}
+
+// one day for every lane; returns a mask of the lanes that drew a day
+// they'd already seen
+template<int Days, int Lanes>
+uint32_t BitsetTrials<Days, Lanes>::step() {
+#if defined(__AVX2__)
+    uint32_t hits = 0;
+    for (int l = 0; l < Lanes; l += 4) {
+        __m256i s0 = _mm256_load_si256((const __m256i*)&s[0][l]);
+        __m256i s1 = _mm256_load_si256((const __m256i*)&s[1][l]);
+        __m256i s2 = _mm256_load_si256((const __m256i*)&s[2][l]);
+        __m256i s3 = _mm256_load_si256((const __m256i*)&s[3][l]);
+
+        // xoshiro256**, with the multiplies by 5 and 9 as shifts and adds
+        __m256i x = _mm256_add_epi64(s1, _mm256_slli_epi64(s1, 2));
+        x = _mm256_or_si256(_mm256_slli_epi64(x, 7), _mm256_srli_epi64(x, 57));
+        __m256i result = _mm256_add_epi64(x, _mm256_slli_epi64(x, 3));
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+        _mm256_store_si256((__m256i*)&s[0][l], s0);
+        _mm256_store_si256((__m256i*)&s[1][l], s1);
+        _mm256_store_si256((__m256i*)&s[2][l], s2);
+        _mm256_store_si256((__m256i*)&s[3][l], s3);
+
+        // the day is the top 32 bits scaled to [0, Days)
+        __m256i day = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(result, 32), _mm256_set1_epi64x(Days)), 32);
+        __m256i bit = _mm256_sllv_epi64(_mm256_set1_epi64x(1), _mm256_and_si256(day, _mm256_set1_epi64x(63)));
+        __m256i word = _mm256_srli_epi64(day, 6);
+        __m256i h = _mm256_setzero_si256();
+        for (int w = 0; w < Words; ++w) {
+            __m256i m = _mm256_and_si256(_mm256_cmpeq_epi64(word, _mm256_set1_epi64x(w)), bit);
+            __m256i set = _mm256_load_si256((const __m256i*)&seen[w][l]);
+            h = _mm256_or_si256(h, _mm256_and_si256(set, m));
+            _mm256_store_si256((__m256i*)&seen[w][l], _mm256_or_si256(set, m));
+        }
+        __m256i missed = _mm256_cmpeq_epi64(h, _mm256_setzero_si256());
+        hits |= (~_mm256_movemask_pd(_mm256_castsi256_pd(missed)) & 0xf) << l;
+
+        __m256i n = _mm256_load_si256((const __m256i*)&steps[l]);
+        _mm256_store_si256((__m256i*)&steps[l], _mm256_add_epi64(n, _mm256_set1_epi64x(1)));
+    }
+    return hits;
+#else
+    uint32_t hits = 0;
+    for (int l = 0; l < Lanes; ++l) {
+        uint64_t x = s[1][l] * 5;
+        uint64_t result = ((x << 7) | (x >> 57)) * 9;
+        uint64_t t = s[1][l] << 17;
+        s[2][l] ^= s[0][l];
+        s[3][l] ^= s[1][l];
+        s[1][l] ^= s[2][l];
+        s[0][l] ^= s[3][l];
+        s[2][l] ^= t;
+        s[3][l] = (s[3][l] << 45) | (s[3][l] >> 19);
+
+        uint64_t day = ((result >> 32) * Days) >> 32;
+        uint64_t h = seen[day >> 6][l] & (1ULL << (day & 63));
+        seen[day >> 6][l] |= 1ULL << (day & 63);
+        hits |= (uint32_t)(h != 0) << l;
+        ++steps[l];
+    }
+    return hits;
+#endif
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Split block Bloom filter. A key sets 8 bits, one in each 64-bit word
+ * of a single 64 byte block, so checking a key reads one cache line.
+ * The block comes from the high half of the 64-bit hash and the bits
+ * from the low half. Sized at 16 bits per key or more, fewer than 1 in
+ * 1000 keys that were never inserted get through.
+ *
+ * Keys can't be taken out again; a filter is rebuilt from scratch
+ * instead.
+ */
+class BlockedBloom {
+public:
+    BlockedBloom();
+    BlockedBloom(const BlockedBloom&) = delete;
+    BlockedBloom& operator=(const BlockedBloom&) = delete;
+    ~BlockedBloom();
+    void reset(int items);
+    void insert(uint64_t h);
+    bool mayContain(uint64_t h) const;
+    void swap(BlockedBloom& other);
+    size_t bytes() const { return sizeof(Block) * blockCount; }
+
+private:
+    struct alignas(64) Block {
+        uint64_t word[8];
+    };
+
+    static const int bitsPerKey = 16;
+    static const uint32_t salt[8];
+
+    Block* blocks;
+    int blockCount;
+    uint64_t mask;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// init static vars; odd multipliers that each pick one bit of a word
+inline const uint32_t BlockedBloom::salt[8]
+        = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+// constructor
+inline BlockedBloom::BlockedBloom() {
+    blocks = nullptr;
+    blockCount = 0;
+    mask = 0;
+}
+
+// destructor
+inline BlockedBloom::~BlockedBloom() {
+    delete[] blocks;
+}
+
+// empties the filter and sizes it for items keys; 0 frees it
+inline void BlockedBloom::reset(int items) {
+    delete[] blocks;
+    blocks = nullptr;
+    blockCount = 0;
+    mask = 0;
+    if (items <= 0)
+        return;
+
+    // a power of two number of blocks
+    long long bits = (long long)items * bitsPerKey;
+    blockCount = 1;
+    while ((long long)blockCount * 512 < bits)
+        blockCount *= 2;
+    mask = blockCount - 1;
+    blocks = new Block[blockCount];
+    memset((void*)blocks, 0, sizeof(Block) * blockCount);
+}
+
+inline void BlockedBloom::insert(uint64_t h) {
+    Block& b = blocks[(h >> 32) & mask];
+    uint32_t x = h;
+    for (int i = 0; i < 8; ++i)
+        b.word[i] |= 1ULL << ((x * salt[i]) >> 26);
+}
+
+// false means h was never inserted
+inline bool BlockedBloom::mayContain(uint64_t h) const {
+    const Block& b = blocks[(h >> 32) & mask];
+    uint32_t x = h;
+    uint64_t all = 1;
+    for (int i = 0; i < 8; ++i)
+        all &= b.word[i] >> ((x * salt[i]) >> 26);
+    return all != 0;
+}
+
+inline void BlockedBloom::swap(BlockedBloom& other) {
+    std::swap(blocks, other.blocks);
+    std::swap(blockCount, other.blockCount);
+    std::swap(mask, other.mask);
+}
+
+#endif
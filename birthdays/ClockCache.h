@@ -0,0 +1,129 @@
+#ifndef CLOCKCACHE_H
+#define CLOCKCACHE_H
+
+#include "HashPolicies.h"
+#include "Hashtable.h"
+#include "UniversalHash.h"
+#include <string>
+#include <utility>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// a cached value and its CLOCK bit, stored together in the table's item
+template<class T>
+struct CacheEntry {
+    CacheEntry() : val(), referenced(false) {}
+    T val;
+    // set when the entry is hit or overwritten, cleared as the hand passes
+    bool referenced;
+};
+
+/**
+ * Fixed size cache on top of a Hashtable, evicting with CLOCK. Each
+ * entry's reference bit lives in its item. The clock hand is an
+ * iterator over the table's slots: an eviction walks it forward,
+ * clearing set bits, and erases the first entry whose bit was already
+ * clear. New entries start with the bit clear, so keys that are only
+ * ever seen once go first and a stream of them can't push out keys
+ * that keep getting hit.
+ *
+ * The table is made big enough that it never resizes, and it uses
+ * linear probing, so an add never moves an item and the hand stays
+ * valid. Memory stays at capacity entries however long the cache runs.
+ * lookup sets the bit in place and allocates nothing.
+ */
+template<class T, class Hash = UniversalHash, class Key = std::string>
+class ClockCache {
+public:
+    typedef typename KeyTraits<Key>::View View;
+    typedef Hashtable<CacheEntry<T>, Hash, LinearProbe, Key> Table;
+
+    ClockCache(bool debug = false, int capacity = 1024);
+    const T* lookup(View k);
+    template<class K>
+    bool add(K&& k, const T& val);
+    int size() const { return entries; }
+    int capacity() const { return cap; }
+    long long hits() const { return hitCount; }
+    long long misses() const { return missCount; }
+    long long evictions() const { return evictionCount; }
+
+private:
+    static_assert(!KeyTraits<Key>::arena, "arena keys would grow the cache's memory without bound");
+
+    void evict(const CacheEntry<T>* keep);
+
+    int cap;
+    int entries;
+    Table table;
+    typename Table::iterator hand;
+    long long hitCount;
+    long long missCount;
+    long long evictionCount;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor; the table stays under half full with one entry more than
+// capacity in it, so it never resizes
+template<class T, class Hash, class Key>
+ClockCache<T, Hash, Key>::ClockCache(bool debug, int capacity)
+        : cap(capacity > 0 ? capacity : 1), entries(0), table(debug, 2 * (capacity > 0 ? capacity : 1) + 5),
+          hitCount(0), missCount(0), evictionCount(0) {
+    hand = table.end();
+}
+
+// k's value, or nullptr on a miss; good until the next add
+template<class T, class Hash, class Key>
+const T* ClockCache<T, Hash, Key>::lookup(View k) {
+    typename Table::iterator it = table.find(k);
+    if (it == table.end()) {
+        ++missCount;
+        return nullptr;
+    }
+
+    ++hitCount;
+    it->val.referenced = true;
+    return &it->val.val;
+}
+
+// adds k with val, or overwrites k's value, evicting an entry if the
+// cache is over capacity; returns whether k was added
+template<class T, class Hash, class Key>
+template<class K>
+bool ClockCache<T, Hash, Key>::add(K&& k, const T& val) {
+    std::pair<CacheEntry<T>&, bool> entry = table.findOrInsert(std::forward<K>(k));
+    entry.first.val = val;
+    entry.first.referenced = !entry.second;
+
+    // the entry just added is passed over, or a full cache of
+    // referenced entries would sweep round and drop it straight away
+    if (entry.second && ++entries > cap)
+        evict(&entry.first);
+    return entry.second;
+}
+
+// sweeps the hand to the first entry other than keep not referenced
+// since the last sweep and erases it; after one turn every other bit is
+// clear, so this ends
+template<class T, class Hash, class Key>
+void ClockCache<T, Hash, Key>::evict(const CacheEntry<T>* keep) {
+    while (true) {
+        if (hand == table.end())
+            hand = table.begin();
+        if (!hand->val.referenced && &hand->val != keep)
+            break;
+        hand->val.referenced = false;
+        ++hand;
+    }
+
+    hand = table.erase(hand);
+    --entries;
+    ++evictionCount;
+}
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef CONCURRENTHASHTABLE_H
+#define CONCURRENTHASHTABLE_H
+
+#include "HashPolicies.h"
+#include "Hashtable.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// a small number unique to the calling thread
+int concurrentThreadIndex();
+
+/**
+ * Epoch based reclamation. A reader holds a Guard while it uses shared
+ * memory; memory that's been unpublished is retire()d and only freed
+ * once every reader that could still see it has let go of its Guard.
+ * Entering and leaving only writes to the reader's own cache line.
+ */
+class EpochDomain {
+public:
+    class Guard {
+    public:
+        Guard(EpochDomain& domain);
+        ~Guard();
+
+    private:
+        EpochDomain& domain;
+        int slot;
+    };
+
+    EpochDomain();
+    ~EpochDomain();
+    void retire(void* p, void (*deleter)(void*));
+    void reclaim();
+
+private:
+    struct Retired {
+        void* p;
+        void (*deleter)(void*);
+        unsigned long long epoch;
+    };
+
+    // 0 means the slot's reader isn't inside a Guard
+    struct alignas(64) Slot {
+        std::atomic<unsigned long long> epoch;
+    };
+
+    static const int maxSlots = 256;
+
+    std::atomic<unsigned long long> globalEpoch;
+    Slot slots[maxSlots];
+    std::mutex retiredLock;
+    std::vector<Retired> retired;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Thread safe version of Hashtable with the same add/lookup interface.
+ *
+ * lookup never blocks or writes to shared memory: it reads the current
+ * table and probes it with plain atomic loads, so readers scale with
+ * the number of cores. add claims an empty slot with a compare-and-swap,
+ * so writers only contend when they race for the same slot.
+ *
+ * Each writer also holds one of a set of striped locks, and a resize
+ * takes all of them. That keeps writers out while the items are copied
+ * to the bigger table, but readers carry on using the old table. The
+ * old table is retired through an EpochDomain and freed once no reader
+ * can still be probing it.
+ *
+ * Items are never removed, so a reference returned by lookup stays good
+ * for the life of the table. Robin hood probing moves items around and
+ * can't be used here.
+ */
+template<class T, class Hash = UniversalHash, class Probe = QuadraticProbe, class Key = std::string,
+        class Growth = PrimeGrowth>
+class ConcurrentHashtable {
+public:
+    typedef typename KeyTraits<Key>::View View;
+
+    ConcurrentHashtable(bool debug = false, unsigned int size = 11);
+    ~ConcurrentHashtable();
+    template<class K>
+    int add(K&& k, const T& val);
+    const T& lookup(View k);
+    void resize();
+
+private:
+    struct Table {
+        Table(bool debug, int size);
+        ~Table();
+        static void destroy(void* p);
+
+        int m;
+        Growth growth;
+        Hash hasher;
+        std::atomic<Item<T, Key>*>* slots;
+    };
+
+    struct alignas(64) Stripe {
+        std::mutex lock;
+    };
+
+    void grow(Table* seen, bool force);
+
+    static const int stripeCount = 64;
+    static_assert(!Probe::robinHood, "ConcurrentHashtable can't move items between slots");
+    static_assert(!KeyTraits<Key>::arena, "ConcurrentHashtable has no key arena");
+
+    bool debug;
+    std::atomic<Table*> current;
+    std::atomic<int> itemsInTable;
+    Stripe stripes[stripeCount];
+    EpochDomain epochs;
+    T garbage;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+inline int concurrentThreadIndex() {
+    static std::atomic<int> next(0);
+    thread_local int index = next++;
+    return index;
+}
+
+inline EpochDomain::Guard::Guard(EpochDomain& domain) : domain(domain) {
+    // claim this thread's slot, or the next free one if it's shared
+    slot = concurrentThreadIndex() % maxSlots;
+    while (true) {
+        unsigned long long idle = 0;
+        unsigned long long now = domain.globalEpoch.load();
+        if (domain.slots[slot].epoch.compare_exchange_strong(idle, now))
+            break;
+        slot = (slot + 1) % maxSlots;
+    }
+}
+
+inline EpochDomain::Guard::~Guard() {
+    domain.slots[slot].epoch.store(0, std::memory_order_release);
+}
+
+inline EpochDomain::EpochDomain() : globalEpoch(1) {
+    for (int i = 0; i < maxSlots; ++i)
+        slots[i].epoch.store(0, std::memory_order_relaxed);
+}
+
+inline EpochDomain::~EpochDomain() {
+    for (Retired& r : retired)
+        r.deleter(r.p);
+}
+
+// p must already be unreachable for new readers
+inline void EpochDomain::retire(void* p, void (*deleter)(void*)) {
+    unsigned long long epoch = globalEpoch.fetch_add(1);
+    std::lock_guard<std::mutex> hold(retiredLock);
+    retired.push_back({p, deleter, epoch});
+}
+
+// frees whatever no reader can still see
+inline void EpochDomain::reclaim() {
+    unsigned long long oldest = globalEpoch.load();
+    for (int i = 0; i < maxSlots; ++i) {
+        unsigned long long epoch = slots[i].epoch.load();
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+
+    std::vector<Retired> freeable;
+    {
+        std::lock_guard<std::mutex> hold(retiredLock);
+        for (size_t i = 0; i < retired.size();) {
+            if (retired[i].epoch < oldest) {
+                freeable.push_back(retired[i]);
+                retired[i] = retired.back();
+                retired.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+    for (Retired& r : freeable)
+        r.deleter(r.p);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+ConcurrentHashtable<T, Hash, Probe, Key, Growth>::Table::Table(bool debug, int size) {
+    growth.setSize(size);
+    m = growth.size();
+    hasher = Hash(debug, m);
+    slots = new std::atomic<Item<T, Key>*>[m];
+    for (int i = 0; i < m; ++i)
+        slots[i].store(nullptr, std::memory_order_relaxed);
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+ConcurrentHashtable<T, Hash, Probe, Key, Growth>::Table::~Table() {
+    delete[] slots;
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+void ConcurrentHashtable<T, Hash, Probe, Key, Growth>::Table::destroy(void* p) {
+    delete static_cast<Table*>(p);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<class T, class Hash, class Probe, class Key, class Growth>
+ConcurrentHashtable<T, Hash, Probe, Key, Growth>::ConcurrentHashtable(bool debug, unsigned int size)
+        : debug(debug), itemsInTable(0), garbage() {
+    current.store(new Table(debug, size));
+}
+
+// destructor
+template<class T, class Hash, class Probe, class Key, class Growth>
+ConcurrentHashtable<T, Hash, Probe, Key, Growth>::~ConcurrentHashtable() {
+    // dealloc; older tables only hold copies of these pointers
+    Table* t = current.load();
+    for (int i = 0; i < t->m; ++i) {
+        Item<T, Key>* item = t->slots[i].load(std::memory_order_relaxed);
+        if (item != nullptr)
+            delete item;
+    }
+    delete t;
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+int ConcurrentHashtable<T, Hash, Probe, Key, Growth>::add(K&& k, const T& val) {
+    View view = k;
+    Item<T, Key>* item = nullptr;
+    while (true) {
+        Table* t;
+        int m;
+        int probeCount = 0;
+        bool placed = false;
+        {
+            // keeps a resize from swapping the table out from under us
+            std::lock_guard<std::mutex> hold(stripes[concurrentThreadIndex() % stripeCount].lock);
+            t = current.load(std::memory_order_acquire);
+            // t may be freed once the lock is released
+            m = t->m;
+
+            // probe, claiming the first empty slot
+            int hashNum = t->growth.reduce(t->hasher(view));
+            int newHash = hashNum;
+            while (true) {
+                Item<T, Key>* cur = t->slots[newHash].load(std::memory_order_acquire);
+                if (cur == nullptr) {
+                    if (item == nullptr) {
+                        item = new Item<T, Key>(hashNum, std::forward<K>(k), val);
+                        view = item->k;
+                    }
+                    item->home = hashNum;
+                    if (t->slots[newHash].compare_exchange_strong(cur, item, std::memory_order_acq_rel)) {
+                        placed = true;
+                        break;
+                    }
+                    // lost the race, cur is the winner
+                }
+                if (KeyTraits<Key>::equal(cur->k, view) && cur->val == val) {
+                    delete item;
+                    return 0;
+                }
+                if (++probeCount == t->m)
+                    break;
+                newHash = Probe::next(hashNum, probeCount, t->growth);
+            }
+        }
+
+        if (!placed) {
+            // the sequence never reached an empty slot
+            grow(t, true);
+            continue;
+        }
+
+        int count = ++itemsInTable;
+        if ((double)(count + 1) / m > 0.5)
+            grow(t, false);
+
+        return probeCount;
+    }
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+const T& ConcurrentHashtable<T, Hash, Probe, Key, Growth>::lookup(View k) {
+    EpochDomain::Guard guard(epochs);
+    Table* t = current.load(std::memory_order_acquire);
+
+    // probe
+    int hashNum = t->growth.reduce(t->hasher(k));
+    int newHash = hashNum;
+    int probeCount = 0;
+    Item<T, Key>* item;
+    while ((item = t->slots[newHash].load(std::memory_order_acquire)) != nullptr) {
+        if (KeyTraits<Key>::equal(item->k, k))
+            return item->val;
+        if (++probeCount == t->m)
+            break;
+        newHash = Probe::next(hashNum, probeCount, t->growth);
+    }
+
+    return garbage;
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+void ConcurrentHashtable<T, Hash, Probe, Key, Growth>::resize() {
+    grow(current.load(std::memory_order_acquire), true);
+}
+
+// moves everything to a bigger table, unless another writer already
+// replaced seen (or, without force, it's no longer over half full)
+template<class T, class Hash, class Probe, class Key, class Growth>
+void ConcurrentHashtable<T, Hash, Probe, Key, Growth>::grow(Table* seen, bool force) {
+    for (int i = 0; i < stripeCount; ++i)
+        stripes[i].lock.lock();
+
+    Table* old = current.load(std::memory_order_relaxed);
+    if (old == seen && (force || (double)(itemsInTable.load() + 1) / old->m > 0.5)) {
+        Table* t = new Table(debug, old->growth.grow());
+
+        // re-hash; nobody else can see t yet
+        for (int i = 0; i < old->m; ++i) {
+            Item<T, Key>* item = old->slots[i].load(std::memory_order_relaxed);
+            if (item == nullptr)
+                continue;
+            int hashNum = t->growth.reduce(t->hasher(item->k));
+            int newHash = hashNum;
+            int probeCount = 0;
+            while (t->slots[newHash].load(std::memory_order_relaxed) != nullptr)
+                newHash = Probe::next(hashNum, ++probeCount, t->growth);
+            item->home = hashNum;
+            t->slots[newHash].store(item, std::memory_order_relaxed);
+        }
+
+        current.store(t, std::memory_order_release);
+        epochs.retire(old, &Table::destroy);
+    }
+
+    for (int i = stripeCount - 1; i >= 0; --i)
+        stripes[i].lock.unlock();
+
+    epochs.reclaim();
+}
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef CUCKOOHASHTABLE_H
+#define CUCKOOHASHTABLE_H
+
+#include "HashPolicies.h"
+#include "Hashtable.h"
+#include "UniversalHash.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Bucketized cuckoo hashtable. Every key has exactly two buckets of 4
+ * slots it can live in, so a lookup looks at no more than 8 slots plus
+ * a small stash, however full or unlucky the table is.
+ *
+ * Each slot has a 1 byte tag from the key's hash, and a key's second
+ * bucket is its first one xor a mix of the tag. An item can then be
+ * moved to its other bucket without rehashing its key. When both
+ * buckets are full, add kicks a random item out to its other bucket,
+ * and so on until one lands in a free slot. If that takes too long, the
+ * last item kicked out goes in the stash, and the table doubles once
+ * the stash overflows. Tables stay fast well past 90% full.
+ *
+ * A key is only stored once: adding a key that's already there keeps
+ * its value and returns 0, so lookup finds the same value Hashtable's
+ * does. Otherwise add returns 0 for items that fit in their first
+ * bucket, 1 for the second bucket and more when items had to be kicked
+ * out, or -1, leaving the key out, when its buckets and the stash are
+ * full of keys with the same hash. lookup returns garbage on a miss.
+ */
+template<class T, class Key = std::string>
+class CuckooHashtable {
+public:
+    typedef typename KeyTraits<Key>::View View;
+
+    CuckooHashtable(bool debug = false, unsigned int size = 16);
+    ~CuckooHashtable();
+    template<class K>
+    int add(K&& k, const T& val);
+    const T& lookup(View k) const;
+    void reportAll(std::ostream& out) const;
+    void resize();
+    uint64_t hash(View k) const;
+
+private:
+    static const int slotsPerBucket = 4;
+    static const int maxKicks = 500;
+    static const int stashSize = 8;
+    static_assert(!KeyTraits<Key>::arena, "CuckooHashtable has no key arena");
+
+    static uint8_t tagOf(uint64_t h);
+    int alternate(int bucket, uint8_t tag) const;
+    int emptySlot(int bucket) const;
+    int place(Item<T, Key>& item, uint8_t tag, int bucket);
+    bool sharesHash(int first, int second, uint64_t h) const;
+    uint32_t nextRandom();
+
+    bool debug;
+    int buckets;
+    int mask;
+    int itemsInTable;
+    UniversalHash hasher;
+    // 0 marks an empty slot
+    uint8_t* tags;
+    Item<T, Key>* slots;
+    std::vector<Item<T, Key>> stash;
+    uint32_t kickState;
+    T garbage;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<class T, class Key>
+CuckooHashtable<T, Key>::CuckooHashtable(bool debug, unsigned int size) {
+    this->debug = debug;
+
+    // enough power of two buckets for size items
+    buckets = 2;
+    while ((unsigned int)buckets * slotsPerBucket < size)
+        buckets *= 2;
+    mask = buckets - 1;
+    itemsInTable = 0;
+
+    tags = new uint8_t[buckets * slotsPerBucket];
+    memset(tags, 0, buckets * slotsPerBucket);
+    slots = static_cast<Item<T, Key>*>(::operator new(sizeof(Item<T, Key>) * buckets * slotsPerBucket));
+
+    // init r; the buckets are picked from the mixed hash
+    hasher = UniversalHash(debug, largestIntPrime);
+    kickState = debug ? 1 : (uint32_t)hashSeed() | 1;
+    garbage = T();
+}
+
+// destructor
+template<class T, class Key>
+CuckooHashtable<T, Key>::~CuckooHashtable() {
+    // dealloc
+    for (int i = 0; i < buckets * slotsPerBucket; ++i)
+        if (tags[i] != 0)
+            slots[i].~Item<T, Key>();
+    ::operator delete(slots);
+    delete[] tags;
+}
+
+template<class T, class Key>
+template<class K>
+int CuckooHashtable<T, Key>::add(K&& k, const T& val) {
+    View view = k;
+    uint64_t h = hash(view);
+    uint8_t tag = tagOf(h);
+    int first = h & mask;
+    int second = alternate(first, tag);
+
+    // duplicates, whatever their value
+    for (int b : {first, second})
+        for (int i = b * slotsPerBucket; i < (b + 1) * slotsPerBucket; ++i)
+            if (tags[i] == tag && KeyTraits<Key>::equal(slots[i].k, view))
+                return 0;
+    for (const Item<T, Key>& item : stash)
+        if (KeyTraits<Key>::equal(item.k, view))
+            return 0;
+
+    // the stash is full and both buckets hold keys with this very hash,
+    // which no amount of doubling will split up
+    if ((int)stash.size() >= stashSize && sharesHash(first, second, h))
+        return -1;
+
+    Item<T, Key> item(first, std::forward<K>(k), val);
+    int moves = place(item, tag, first);
+    ++itemsInTable;
+
+    // grow once the stash overflows, or nearly every slot is full
+    if ((int)stash.size() > stashSize || 20 * itemsInTable > 19 * buckets * slotsPerBucket)
+        resize();
+
+    return moves;
+}
+
+template<class T, class Key>
+const T& CuckooHashtable<T, Key>::lookup(View k) const {
+    uint64_t h = hash(k);
+    uint8_t tag = tagOf(h);
+    int first = h & mask;
+
+    // at most two buckets and the stash
+    for (int b : {first, alternate(first, tag)})
+        for (int i = b * slotsPerBucket; i < (b + 1) * slotsPerBucket; ++i)
+            if (tags[i] == tag && KeyTraits<Key>::equal(slots[i].k, k))
+                return slots[i].val;
+    for (const Item<T, Key>& item : stash)
+        if (KeyTraits<Key>::equal(item.k, k))
+            return item.val;
+
+    return garbage;
+}
+
+template<class T, class Key>
+void CuckooHashtable<T, Key>::reportAll(std::ostream& out) const {
+    for (int i = 0; i < buckets * slotsPerBucket; ++i) {
+        if (tags[i] != 0)
+            out << slots[i].k << ' ' << slots[i].val << std::endl;
+    }
+    for (const Item<T, Key>& item : stash)
+        out << item.k << ' ' << item.val << std::endl;
+}
+
+template<class T, class Key>
+void CuckooHashtable<T, Key>::resize() {
+    int oldSize = buckets * slotsPerBucket;
+    uint8_t* oldTags = tags;
+    Item<T, Key>* oldSlots = slots;
+    std::vector<Item<T, Key>> oldStash;
+    oldStash.swap(stash);
+
+    // new table, swap tables
+    buckets *= 2;
+    mask = buckets - 1;
+    tags = new uint8_t[buckets * slotsPerBucket];
+    memset(tags, 0, buckets * slotsPerBucket);
+    slots = static_cast<Item<T, Key>*>(::operator new(sizeof(Item<T, Key>) * buckets * slotsPerBucket));
+
+    // re-hash, moving items straight into their new slots
+    auto reinsert = [&](Item<T, Key>& item) {
+        uint64_t h = hash(item.k);
+        place(item, tagOf(h), h & mask);
+    };
+    for (int i = 0; i < oldSize; ++i)
+        if (oldTags[i] != 0) {
+            reinsert(oldSlots[i]);
+            oldSlots[i].~Item<T, Key>();
+        }
+    for (Item<T, Key>& item : oldStash)
+        reinsert(item);
+
+    // dealloc
+    ::operator delete(oldSlots);
+    delete[] oldTags;
+}
+
+template<class T, class Key>
+uint64_t CuckooHashtable<T, Key>::hash(View k) const {
+    return mix64(hasher(k));
+}
+
+// the top byte of the hash, never 0
+template<class T, class Key>
+uint8_t CuckooHashtable<T, Key>::tagOf(uint64_t h) {
+    uint8_t tag = h >> 56;
+    return tag != 0 ? tag : 1;
+}
+
+// each bucket of a key is the other's alternate
+template<class T, class Key>
+int CuckooHashtable<T, Key>::alternate(int bucket, uint8_t tag) const {
+    return (bucket ^ (tag * 0x5bd1e995u)) & mask;
+}
+
+template<class T, class Key>
+int CuckooHashtable<T, Key>::emptySlot(int bucket) const {
+    for (int i = bucket * slotsPerBucket; i < (bucket + 1) * slotsPerBucket; ++i)
+        if (tags[i] == 0)
+            return i;
+    return -1;
+}
+
+// moves item into a free slot of bucket or its alternate, kicking other
+// items out to their alternates if both are full; returns how many
+// moves that took. If it takes too many, the item last kicked out goes
+// in the stash instead
+template<class T, class Key>
+int CuckooHashtable<T, Key>::place(Item<T, Key>& item, uint8_t tag, int bucket) {
+    int moves = 0;
+    int slot = emptySlot(bucket);
+    if (slot < 0) {
+        bucket = alternate(bucket, tag);
+        slot = emptySlot(bucket);
+        ++moves;
+    }
+
+    Item<T, Key> carried(std::move(item));
+    while (slot < 0) {
+        if (moves > maxKicks) {
+            stash.push_back(std::move(carried));
+            return moves;
+        }
+
+        // swap with a random item of the bucket, which then has to
+        // go to its own alternate
+        int victim = bucket * slotsPerBucket + nextRandom() % slotsPerBucket;
+        std::swap(carried, slots[victim]);
+        std::swap(tag, tags[victim]);
+        bucket = alternate(bucket, tag);
+        slot = emptySlot(bucket);
+        ++moves;
+    }
+
+    new (&slots[slot]) Item<T, Key>(std::move(carried));
+    tags[slot] = tag;
+    return moves;
+}
+
+// whether both buckets are full of keys that hash to h
+template<class T, class Key>
+bool CuckooHashtable<T, Key>::sharesHash(int first, int second, uint64_t h) const {
+    for (int b : {first, second})
+        for (int i = b * slotsPerBucket; i < (b + 1) * slotsPerBucket; ++i)
+            if (tags[i] == 0 || hash(slots[i].k) != h)
+                return false;
+    return true;
+}
+
+// xorshift32, to pick which item to kick out
+template<class T, class Key>
+uint32_t CuckooHashtable<T, Key>::nextRandom() {
+    kickState ^= kickState << 13;
+    kickState ^= kickState >> 17;
+    kickState ^= kickState << 5;
+    return kickState;
+}
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef FIXEDHASHTABLE_H
+#define FIXEDHASHTABLE_H
+
+#include "HashPolicies.h"
+#include "Hashtable.h"
+#include "UniversalHash.h"
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// growth policy of a FixedHashtable: the size is M for good, so the
+// fastmod inverse PrimeGrowth works out at run time is a constant here
+template<int M>
+struct FixedGrowth {
+    static_assert(M > 0, "a table needs at least one slot");
+
+    static constexpr int size() { return M; }
+    static constexpr int reduce(unsigned long long x) { return fastmod(x, inverse, M); }
+
+    static constexpr __uint128_t inverse = fastmodInverse(M);
+};
+
+/**
+ * Hashtable with a capacity fixed at compile time and its slots stored
+ * inside the object, so a table on the stack or embedded in another
+ * object never calls the allocator (as long as its keys and values
+ * don't). It never grows: add returns -1 once the probe finds no room.
+ *
+ * It keeps a list of the slots in use, so clear() only visits those
+ * and a table can be reused for many short runs for the cost of what
+ * each run added.
+ *
+ * Tables built from the same Hash hash keys the same way, e.g. one per
+ * thread of a parallel run that has to give the same answer however
+ * many threads it uses.
+ *
+ * add and lookup behave like Hashtable's: add returns the probe count
+ * (0 for duplicates), lookup returns garbage on a miss.
+ */
+template<class T, int Capacity, class Hash = UniversalHash, class Probe = QuadraticProbe, class Key = std::string>
+class FixedHashtable {
+public:
+    typedef typename KeyTraits<Key>::View View;
+
+    FixedHashtable(bool debug = false);
+    explicit FixedHashtable(const Hash& hasher);
+    FixedHashtable(const FixedHashtable&) = delete;
+    FixedHashtable& operator=(const FixedHashtable&) = delete;
+    ~FixedHashtable();
+    template<class K>
+    int add(K&& k, const T& val);
+    const T& lookup(View k) const;
+    void clear();
+    void reportAll(std::ostream& out) const;
+    int hash(View k) const;
+    int items() const { return itemsInTable; }
+    static constexpr int size() { return Capacity; }
+
+private:
+    static_assert(!Probe::robinHood, "FixedHashtable doesn't move items");
+    static_assert(!KeyTraits<Key>::arena, "FixedHashtable has no key arena");
+
+    Item<T, Key>* slot(int i) { return reinterpret_cast<Item<T, Key>*>(storage) + i; }
+    const Item<T, Key>* slot(int i) const { return reinterpret_cast<const Item<T, Key>*>(storage) + i; }
+
+    bool debug;
+    Hash hasher;
+    FixedGrowth<Capacity> growth;
+    int itemsInTable;
+    alignas(Item<T, Key>) unsigned char storage[sizeof(Item<T, Key>) * Capacity];
+    bool full[Capacity];
+    // the slots filled so far, in order
+    int used[Capacity];
+    T garbage;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<class T, int Capacity, class Hash, class Probe, class Key>
+FixedHashtable<T, Capacity, Hash, Probe, Key>::FixedHashtable(bool debug) : garbage() {
+    this->debug = debug;
+    itemsInTable = 0;
+    for (int i = 0; i < Capacity; ++i)
+        full[i] = false;
+
+    // init r
+    hasher = Hash(debug, Capacity);
+}
+
+// constructor; hashes with a copy of hasher, which should have been
+// made for Capacity slots
+template<class T, int Capacity, class Hash, class Probe, class Key>
+FixedHashtable<T, Capacity, Hash, Probe, Key>::FixedHashtable(const Hash& hasher) : hasher(hasher), garbage() {
+    debug = false;
+    itemsInTable = 0;
+    for (int i = 0; i < Capacity; ++i)
+        full[i] = false;
+}
+
+// destructor
+template<class T, int Capacity, class Hash, class Probe, class Key>
+FixedHashtable<T, Capacity, Hash, Probe, Key>::~FixedHashtable() {
+    clear();
+}
+
+template<class T, int Capacity, class Hash, class Probe, class Key>
+template<class K>
+int FixedHashtable<T, Capacity, Hash, Probe, Key>::add(K&& k, const T& val) {
+    View view = k;
+    int home = hash(view);
+
+    // probe
+    int newHash = home;
+    int probeCount = 0;
+    while (full[newHash]) {
+        const Item<T, Key>* item = slot(newHash);
+        if (KeyTraits<Key>::equal(item->k, view) && item->val == val)
+            return 0;
+        if (++probeCount == Capacity)
+            return -1;
+        newHash = Probe::next(home, probeCount, growth);
+    }
+
+    new (slot(newHash)) Item<T, Key>(home, std::forward<K>(k), val);
+    full[newHash] = true;
+    used[itemsInTable++] = newHash;
+
+    return probeCount;
+}
+
+template<class T, int Capacity, class Hash, class Probe, class Key>
+const T& FixedHashtable<T, Capacity, Hash, Probe, Key>::lookup(View k) const {
+    int home = hash(k);
+
+    // probe
+    int newHash = home;
+    int probeCount = 0;
+    while (full[newHash]) {
+        const Item<T, Key>* item = slot(newHash);
+        if (KeyTraits<Key>::equal(item->k, k))
+            return item->val;
+        if (++probeCount == Capacity)
+            break;
+        newHash = Probe::next(home, probeCount, growth);
+    }
+
+    return garbage;
+}
+
+// empties the table, visiting only the slots in use
+template<class T, int Capacity, class Hash, class Probe, class Key>
+void FixedHashtable<T, Capacity, Hash, Probe, Key>::clear() {
+    for (int i = 0; i < itemsInTable; ++i) {
+        slot(used[i])->~Item<T, Key>();
+        full[used[i]] = false;
+    }
+    itemsInTable = 0;
+}
+
+template<class T, int Capacity, class Hash, class Probe, class Key>
+void FixedHashtable<T, Capacity, Hash, Probe, Key>::reportAll(std::ostream& out) const {
+    for (int i = 0; i < Capacity; ++i) {
+        if (full[i])
+            out << slot(i)->k << ' ' << slot(i)->val << std::endl;
+    }
+}
+
+template<class T, int Capacity, class Hash, class Probe, class Key>
+int FixedHashtable<T, Capacity, Hash, Probe, Key>::hash(View k) const {
+    return growth.reduce(hasher(k));
+}
+
+#endif
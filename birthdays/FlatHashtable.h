@@ -0,0 +1,348 @@
+#ifndef FLATHASHTABLE_H
+#define FLATHASHTABLE_H
+
+#include "HashPolicies.h"
+#include "KeyArena.h"
+#include "UniversalHash.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// a full slot's ctrl byte holds the low 7 bits of its hash,
+// so only empty slots have the high bit set
+static const signed char ctrlEmpty = -128;
+
+/**
+ * Scans the ctrl bytes of one group of slots at once. Every match
+ * returns a bitmask with bit i set if slot i of the group matched.
+ */
+struct FlatGroup {
+#if defined(__AVX2__)
+    static const int width = 32;
+#elif defined(__SSE2__)
+    static const int width = 16;
+#else
+    static const int width = 8;
+#endif
+    static uint32_t match(const signed char* ctrl, signed char tag);
+    static uint32_t matchEmpty(const signed char* ctrl);
+};
+
+// a string key kept in its slot: up to inlineBytes bytes in place, and
+// a longer key as a view of its bytes in the table's KeyArena
+struct FlatKey {
+    static const int inlineBytes = 31;
+
+    FlatKey(std::string_view k, KeyArena& arena);
+    operator std::string_view() const;
+
+    char bytes[inlineBytes];
+    // more than inlineBytes means bytes holds the arena view
+    unsigned char len;
+};
+
+template<>
+struct KeyTraits<FlatKey> {
+    typedef std::string_view View;
+    static const bool arena = true;
+    static bool equal(const FlatKey& a, std::string_view b);
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Open addressing hashtable that stores its items inline in one
+ * contiguous slot array, next to an array of 1-byte ctrl tags. Probes
+ * scan the tags a whole group at a time and only touch a slot when its
+ * tag matches, so a lookup usually costs a single miss in the slots.
+ *
+ * A slot holds the key itself, not a pointer to it, so a tag match
+ * compares the key in the line it already loaded. std::array<char, N>
+ * keys are stored whole, as are std::string keys of up to 31 bytes;
+ * only longer ones go to a KeyArena.
+ *
+ * add and lookup behave like Hashtable's: add returns how many groups
+ * past the first it had to probe (0 for duplicates), lookup returns
+ * garbage on a miss.
+ */
+template<class T, class Key = std::string>
+class FlatHashtable {
+public:
+    typedef typename KeyTraits<Key>::View View;
+
+    FlatHashtable(bool debug = false, unsigned int size = 16);
+    FlatHashtable(const FlatHashtable&) = delete;
+    FlatHashtable& operator=(const FlatHashtable&) = delete;
+    ~FlatHashtable();
+    template<class K>
+    int add(K&& k, const T& val);
+    const T& lookup(View k) const;
+    void reportAll(std::ostream& out) const;
+    void resize();
+    uint64_t hash(View k) const;
+
+private:
+    // string keys are kept in FlatKeys
+    static const bool stringKeys = KeyTraits<Key>::arena || std::is_same<Key, std::string>::value;
+    typedef typename std::conditional<stringKeys, FlatKey, Key>::type Stored;
+
+    struct Slot {
+        Stored k;
+        T val;
+    };
+
+    void setCtrl(int i, signed char c);
+    int findEmpty(uint64_t h) const;
+
+    bool debug;
+    int m;
+    int mask;
+    int itemsInTable;
+    UniversalHash hasher;
+    signed char* ctrl;
+    Slot* slots;
+    KeyArena keyArena;
+    T garbage;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+inline uint32_t FlatGroup::match(const signed char* ctrl, signed char tag) {
+#if defined(__AVX2__)
+    __m256i group = _mm256_loadu_si256((const __m256i*)ctrl);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(tag)));
+#elif defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < width; ++i)
+        if (ctrl[i] == tag)
+            bits |= 1u << i;
+    return bits;
+#endif
+}
+
+inline uint32_t FlatGroup::matchEmpty(const signed char* ctrl) {
+#if defined(__AVX2__)
+    return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)ctrl));
+#elif defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    uint32_t bits = 0;
+    for (int i = 0; i < width; ++i)
+        if (ctrl[i] < 0)
+            bits |= 1u << i;
+    return bits;
+#endif
+}
+
+inline FlatKey::FlatKey(std::string_view k, KeyArena& arena) {
+    if (k.size() <= (size_t)inlineBytes) {
+        memcpy(bytes, k.data(), k.size());
+        len = k.size();
+    } else {
+        std::string_view stored = arena.store(k);
+        memcpy(bytes, &stored, sizeof(stored));
+        len = inlineBytes + 1;
+    }
+}
+
+inline FlatKey::operator std::string_view() const {
+    if (len <= inlineBytes)
+        return std::string_view(bytes, len);
+    std::string_view stored;
+    memcpy(&stored, bytes, sizeof(stored));
+    return stored;
+}
+
+inline bool KeyTraits<FlatKey>::equal(const FlatKey& a, std::string_view b) {
+    if (a.len <= FlatKey::inlineBytes)
+        return a.len == b.size() && memcmp(a.bytes, b.data(), b.size()) == 0;
+    return std::string_view(a) == b;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<class T, class Key>
+FlatHashtable<T, Key>::FlatHashtable(bool debug, unsigned int size) {
+    this->debug = debug;
+
+    // round up to a power of two, at least one group
+    m = 2 * FlatGroup::width;
+    while ((unsigned int)m < size)
+        m *= 2;
+    mask = m - 1;
+    itemsInTable = 0;
+
+    // the last width - 1 ctrl bytes mirror the first ones so a group
+    // starting near the end can be loaded without wrapping
+    ctrl = new signed char[m + FlatGroup::width - 1];
+    memset(ctrl, ctrlEmpty, m + FlatGroup::width - 1);
+    slots = static_cast<Slot*>(::operator new(sizeof(Slot) * m));
+
+    // init r; the universal hash runs mod the largest int prime and
+    // the slot is picked from the mixed result instead
+    hasher = UniversalHash(debug, largestIntPrime);
+    garbage = T();
+}
+
+// destructor
+template<class T, class Key>
+FlatHashtable<T, Key>::~FlatHashtable() {
+    // dealloc
+    for (int i = 0; i < m; ++i)
+        if (ctrl[i] >= 0)
+            slots[i].~Slot();
+    ::operator delete(slots);
+    delete[] ctrl;
+}
+
+template<class T, class Key>
+template<class K>
+int FlatHashtable<T, Key>::add(K&& k, const T& val) {
+    View view = k;
+    uint64_t h = hash(view);
+    signed char tag = h & 0x7f;
+
+    // probe a group at a time
+    int pos = (h >> 7) & mask;
+    int stride = 0;
+    int probeCount = 0;
+    while (true) {
+        uint32_t bits = FlatGroup::match(ctrl + pos, tag);
+        while (bits) {
+            int i = (pos + __builtin_ctz(bits)) & mask;
+            if (KeyTraits<Stored>::equal(slots[i].k, view) && slots[i].val == val)
+                return 0;
+            bits &= bits - 1;
+        }
+        uint32_t empty = FlatGroup::matchEmpty(ctrl + pos);
+        if (empty) {
+            pos = (pos + __builtin_ctz(empty)) & mask;
+            break;
+        }
+        stride += FlatGroup::width;
+        pos = (pos + stride) & mask;
+        ++probeCount;
+    }
+
+    if constexpr (stringKeys)
+        new (&slots[pos]) Slot{FlatKey(view, keyArena), val};
+    else
+        new (&slots[pos]) Slot{std::forward<K>(k), val};
+    setCtrl(pos, tag);
+    ++itemsInTable;
+
+    // keep at most 7/8 of the slots full
+    if (8 * itemsInTable > 7 * m)
+        resize();
+
+    return probeCount;
+}
+
+template<class T, class Key>
+const T& FlatHashtable<T, Key>::lookup(View k) const {
+    uint64_t h = hash(k);
+    signed char tag = h & 0x7f;
+
+    // probe
+    int pos = (h >> 7) & mask;
+    int stride = 0;
+    while (true) {
+        uint32_t bits = FlatGroup::match(ctrl + pos, tag);
+        while (bits) {
+            int i = (pos + __builtin_ctz(bits)) & mask;
+            if (KeyTraits<Stored>::equal(slots[i].k, k))
+                return slots[i].val;
+            bits &= bits - 1;
+        }
+        if (FlatGroup::matchEmpty(ctrl + pos))
+            break;
+        stride += FlatGroup::width;
+        pos = (pos + stride) & mask;
+    }
+
+    return garbage;
+}
+
+template<class T, class Key>
+void FlatHashtable<T, Key>::reportAll(std::ostream& out) const {
+    for (int i = 0; i < m; ++i) {
+        if (ctrl[i] >= 0)
+            out << View(slots[i].k) << ' ' << slots[i].val << std::endl;
+    }
+}
+
+template<class T, class Key>
+void FlatHashtable<T, Key>::resize() {
+    int oldSize = m;
+    signed char* oldCtrl = ctrl;
+    Slot* oldSlots = slots;
+
+    // new table, swap tables
+    m *= 2;
+    mask = m - 1;
+    ctrl = new signed char[m + FlatGroup::width - 1];
+    memset(ctrl, ctrlEmpty, m + FlatGroup::width - 1);
+    slots = static_cast<Slot*>(::operator new(sizeof(Slot) * m));
+
+    // re-hash, moving items straight into their new slots
+    for (int i = 0; i < oldSize; ++i)
+        if (oldCtrl[i] >= 0) {
+            uint64_t h = hash(oldSlots[i].k);
+            int pos = findEmpty(h);
+            new (&slots[pos]) Slot(std::move(oldSlots[i]));
+            setCtrl(pos, h & 0x7f);
+            oldSlots[i].~Slot();
+        }
+
+    // dealloc
+    ::operator delete(oldSlots);
+    delete[] oldCtrl;
+}
+
+template<class T, class Key>
+uint64_t FlatHashtable<T, Key>::hash(View k) const {
+    // finalize so both the tag and the slot bits are well mixed
+    return mix64(hasher(k));
+}
+
+template<class T, class Key>
+void FlatHashtable<T, Key>::setCtrl(int i, signed char c) {
+    ctrl[i] = c;
+    // keep the mirrored tail in sync
+    ctrl[((i - (FlatGroup::width - 1)) & mask) + (FlatGroup::width - 1)] = c;
+}
+
+template<class T, class Key>
+int FlatHashtable<T, Key>::findEmpty(uint64_t h) const {
+    int pos = (h >> 7) & mask;
+    int stride = 0;
+    while (true) {
+        uint32_t empty = FlatGroup::matchEmpty(ctrl + pos);
+        if (empty)
+            return (pos + __builtin_ctz(empty)) & mask;
+        stride += FlatGroup::width;
+        pos = (pos + stride) & mask;
+    }
+}
+
+#endif
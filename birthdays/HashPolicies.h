@@ -0,0 +1,320 @@
+#ifndef HASHPOLICIES_H
+#define HASHPOLICIES_H
+
+#include "UniversalHash.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Policies picked at compile time by Hashtable<T, Hash, Probe, Key, Growth>.
+ *
+ * A Hash policy is constructed with (debug, m), picks new seeds on
+ * reseed(m), and maps a key to a hash code with operator() (hashMany
+ * does a batch). UniversalHash, the original hash, is one.
+ *
+ * A Growth policy owns the table size m: it picks the size to grow to
+ * and reduces hash codes and probe offsets into [0, m) without a
+ * hardware divide.
+ *
+ * A Probe policy gives the i-th slot to try after a key's home slot.
+ * robinHood policies also let Hashtable displace items that are closer
+ * to their home than the one being inserted, which needs distance().
+ * linear policies step one slot at a time, which lets Hashtable::erase
+ * shift the rest of a run back over a removed item; they need
+ * distance() too.
+ */
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// how a table passes keys around: std::string keys are looked up and
+// hashed through std::string_view, so callers never build a string just
+// to find one; every other key type is passed as itself. equal compares
+// a stored key with a View, and arena keys are copied into the table's
+// KeyArena (see KeyArena.h)
+template<class Key>
+struct KeyTraits {
+    typedef Key View;
+    static const bool arena = false;
+    static bool equal(const Key& a, View b) { return a == b; }
+};
+
+template<>
+struct KeyTraits<std::string> {
+    typedef std::string_view View;
+    static const bool arena = false;
+    static bool equal(const std::string& a, std::string_view b) { return a == b; }
+};
+
+// fixed width keys, e.g. std::array<char, 30> for 30 letter words; they
+// live inside the item (no allocation of their own) and are compared
+// with two overlapping 16 byte vector compares when N is 16 to 32
+template<size_t N>
+struct KeyTraits<std::array<char, N>> {
+    typedef const std::array<char, N>& View;
+    static const bool arena = false;
+    static bool equal(const std::array<char, N>& a, const std::array<char, N>& b);
+};
+
+// spreads every bit of a hash code over all 64 bits (murmur3's fmix64),
+// for tables that take their slot or shard from the high bits
+uint64_t mix64(uint64_t h);
+
+// CRC32C of the key, using the SSE4.2 crc32 instruction when available
+class Crc32cHash {
+public:
+    Crc32cHash(bool debug = false, int m = 11);
+    void reseed(int m);
+    unsigned long long operator()(std::string_view k) const;
+    unsigned long long operator()(long long k) const;
+    template<size_t N>
+    unsigned long long operator()(const std::array<char, N>& k) const;
+    template<class K>
+    void hashMany(const K* keys, int n, unsigned long long* out) const;
+
+    static uint32_t crc32c(uint32_t crc, const char* data, size_t len);
+
+private:
+    bool debug;
+    uint32_t seed;
+    static const uint32_t seed_default = 0x9e3779b9;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Lemire's fastmod: x % m as a multiply by a precomputed inverse of m;
+// the low 128 bits of x / m, times m, shifted down is x % m
+constexpr __uint128_t fastmodInverse(int m) {
+    return ~(__uint128_t)0 / m + 1;
+}
+
+constexpr int fastmod(unsigned long long x, __uint128_t inverse, int m) {
+    __uint128_t low = inverse * x;
+    __uint128_t bottom = ((low & ~0ULL) * m) >> 64;
+    __uint128_t top = (low >> 64) * m;
+    return (bottom + top) >> 64;
+}
+
+// prime sizes, reduced with Lemire's fastmod (a multiply by a
+// precomputed inverse instead of a divide). Sizes follow m_default
+// and then the next prime past double the size, without limit
+class PrimeGrowth {
+public:
+    void setSize(int size);
+    int size() const { return m; }
+    int grow() const;
+    int reduce(unsigned long long x) const;
+
+    static const int m_default[17];
+
+private:
+    static bool isPrime(int n);
+
+    int m;
+    __uint128_t inverse;
+};
+
+// power of two sizes, reduced with a mask. Pair it with a hash whose low
+// bits are good (Crc32cHash) and a probe that covers every slot
+// (LinearProbe, TriangularProbe or RobinHoodProbe)
+class PowerOfTwoGrowth {
+public:
+    void setSize(int size);
+    int size() const { return m; }
+    int grow() const { return 2 * m; }
+    int reduce(unsigned long long x) const { return x & mask; }
+
+private:
+    int m;
+    unsigned long long mask;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// home, home + 1, home + 2, ...
+struct LinearProbe {
+    static const bool robinHood = false;
+    static const bool linear = true;
+    template<class Growth>
+    static int next(int home, int i, const Growth& g) { return g.reduce(home + (unsigned long long)i); }
+    static int distance(int home, int slot, int m) { return slot >= home ? slot - home : slot + m - home; }
+};
+
+// home, home + 1, home + 4, home + 9, ... (the original probing)
+struct QuadraticProbe {
+    static const bool robinHood = false;
+    static const bool linear = false;
+    template<class Growth>
+    static int next(int home, int i, const Growth& g) { return g.reduce(home + (unsigned long long)i * i); }
+};
+
+// home, home + 1, home + 3, home + 6, ...
+struct TriangularProbe {
+    static const bool robinHood = false;
+    static const bool linear = false;
+    template<class Growth>
+    static int next(int home, int i, const Growth& g) { return g.reduce(home + (unsigned long long)i * (i + 1) / 2); }
+};
+
+// linear probing where an insert takes the slot of any item closer to
+// its home than the insert is, so probe lengths stay even
+struct RobinHoodProbe {
+    static const bool robinHood = true;
+    static const bool linear = true;
+    template<class Growth>
+    static int next(int home, int i, const Growth& g) { return g.reduce(home + (unsigned long long)i); }
+    static int distance(int home, int slot, int m) { return slot >= home ? slot - home : slot + m - home; }
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+inline uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+template<size_t N>
+bool KeyTraits<std::array<char, N>>::equal(const std::array<char, N>& a, const std::array<char, N>& b) {
+#if defined(__SSE2__)
+    if constexpr (N >= 16 && N <= 32) {
+        __m128i lo = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)a.data()), _mm_loadu_si128((const __m128i*)b.data()));
+        __m128i hi = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a.data() + N - 16)),
+                _mm_loadu_si128((const __m128i*)(b.data() + N - 16)));
+        return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xffff;
+    }
+#endif
+    return memcmp(a.data(), b.data(), N) == 0;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// table for the software crc32c, one entry per byte value
+struct Crc32cTable {
+    uint32_t entry[256];
+    constexpr Crc32cTable() : entry() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j)
+                crc = (crc >> 1) ^ (0x82f63b78 & (0 - (crc & 1)));
+            entry[i] = crc;
+        }
+    }
+};
+
+inline constexpr Crc32cTable crc32cTable;
+
+// constructor
+inline Crc32cHash::Crc32cHash(bool debug, int m) {
+    this->debug = debug;
+    seed = seed_default;
+    reseed(m);
+}
+
+inline void Crc32cHash::reseed(int) {
+    if (!debug)
+        seed = hashSeed();
+}
+
+inline unsigned long long Crc32cHash::operator()(std::string_view k) const {
+    return crc32c(seed, k.data(), k.size());
+}
+
+inline unsigned long long Crc32cHash::operator()(long long k) const {
+    return crc32c(seed, (const char*)&k, sizeof(k));
+}
+
+template<size_t N>
+unsigned long long Crc32cHash::operator()(const std::array<char, N>& k) const {
+    return crc32c(seed, k.data(), N);
+}
+
+template<class K>
+void Crc32cHash::hashMany(const K* keys, int n, unsigned long long* out) const {
+    for (int i = 0; i < n; ++i)
+        out[i] = (*this)(keys[i]);
+}
+
+inline uint32_t Crc32cHash::crc32c(uint32_t crc, const char* data, size_t len) {
+    crc = ~crc;
+#if defined(__SSE4_2__)
+    uint64_t crc64 = crc;
+    for (; len >= 8; len -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = crc64;
+    for (; len > 0; --len, ++data)
+        crc = _mm_crc32_u8(crc, *data);
+#else
+    for (; len > 0; --len, ++data)
+        crc = (crc >> 8) ^ crc32cTable.entry[(crc ^ (unsigned char)*data) & 0xff];
+#endif
+    return ~crc;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// init static vars
+inline const int PrimeGrowth::m_default[17]
+        = {11, 23, 47, 97, 197, 397, 797, 1597, 3203, 6421, 12853, 25717, 51437, 102877, 205759, 411527, 823117};
+
+// any size is used as is, so a 365 slot calendar stays 365 slots
+inline void PrimeGrowth::setSize(int size) {
+    m = size;
+    inverse = fastmodInverse(m);
+}
+
+inline int PrimeGrowth::grow() const {
+    for (int i = 0; i < 17; ++i)
+        if (m < m_default[i])
+            return m_default[i];
+
+    // past the list, generate the next prime
+    int next = 2 * m + 1;
+    while (!isPrime(next))
+        next += 2;
+    return next;
+}
+
+inline int PrimeGrowth::reduce(unsigned long long x) const {
+    return fastmod(x, inverse, m);
+}
+
+inline bool PrimeGrowth::isPrime(int n) {
+    if (n % 2 == 0)
+        return n == 2;
+    for (long long d = 3; d * d <= n; d += 2)
+        if (n % d == 0)
+            return false;
+    return true;
+}
+
+inline void PowerOfTwoGrowth::setSize(int size) {
+    m = 1;
+    while (m < size)
+        m *= 2;
+    mask = m - 1;
+}
+
+#endif
@@ -1,221 +1,1032 @@
-#include <cmath>
-#include <ctime>
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+#include "BloomFilter.h"
+#include "HashPolicies.h"
+#include "HashtableStats.h"
+#include "KeyArena.h"
+#include "MappedHashtable.h"
+#include "UniversalHash.h"
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-template<class T>
+template<class T, class Key = std::string>
 struct Item {
-    Item(std::string k, const T& val);
-    bool operator==(Item other);
-    std::string k;
+    template<class K, class... Args>
+    Item(int home, K&& k, Args&&... args);
+    bool operator==(const Item& other) const;
+    Key k;
     T val;
+    // slot the key hashed to, for robin hood probing
+    int home;
 };
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-template<class T>
+/**
+ * Open addressing hashtable. The hash function, probe sequence and
+ * growth policy are policies (see HashPolicies.h), e.g.
+ * Hashtable<int, Crc32cHash, RobinHoodProbe>; the defaults are the
+ * universal hash and quadratic probing over prime sizes. Keys are
+ * std::strings unless Key picks another type (see KeyTraits).
+ */
+template<class T, class Hash = UniversalHash, class Probe = QuadraticProbe, class Key = std::string,
+        class Growth = PrimeGrowth>
 class Hashtable {
 public:
-    Hashtable(bool debug = false, unsigned int size = 11);
+    typedef typename KeyTraits<Key>::View View;
+
+    template<class I>
+    class Cursor;
+    typedef Cursor<Item<T, Key>> iterator;
+    typedef Cursor<const Item<T, Key>> const_iterator;
+
+    Hashtable(bool debug = false, unsigned int size = 11, bool incremental = false, bool prefilter = false);
     ~Hashtable();
-    int add(std::string k, const T& val);
-    const T& lookup(std::string k);
+    template<class K>
+    int add(K&& k, const T& val);
+    template<class K>
+    int add(K&& k, T&& val);
+    template<class K, class... Args>
+    int emplace(K&& k, Args&&... args);
+    template<class K>
+    std::pair<T&, bool> findOrInsert(K&& k);
+    template<class K, class V>
+    bool insertOrAssign(K&& k, V&& val);
+    const T& lookup(View k);
+    bool contains(View k);
+    iterator find(View k);
+    template<class K>
+    void lookupMany(const K* keys, int n, T* out);
+    template<class K>
+    void addMany(const K* keys, const T* vals, int n, int* out = nullptr);
+    bool erase(View k);
+    iterator erase(iterator it);
     void reportAll(std::ostream& out) const;
+    iterator begin();
+    iterator end() { return iterator(this, m + oldM); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m + oldM); }
+    template<class Fn>
+    void parallelForEach(Fn fn, int threads = std::thread::hardware_concurrency());
+    HashtableStats stats() const;
+    bool save(const char* path);
+    static MappedHashtable<T, Hash, Probe, Key, Growth> openMapped(const char* path);
     void resize();
-    int hash(std::string k) const;
+    int hash(View k) const;
+    template<class K>
+    void hashMany(const K* keys, int n, int* out) const;
 
 private:
+    template<class Same, class Make>
+    int insert(View k, int hashNum, Same same, Make make, Item<T, Key>** at = nullptr);
+    template<class Same, class Make>
+    int place(View k, int hashNum, Same same, Make make, Item<T, Key>** at = nullptr);
+    template<class Same>
+    int search(int hashNum, Same same, Item<T, Key>** tbl, const Growth& g, bool stopEarly, int* probes = nullptr) const;
+    const T& get(View k, int hashNum) const;
+    int locate(View k, int hashNum) const;
+    Item<T, Key>* at(int i) const;
+    int slotAt(int pos) const;
+    int positionOf(int slot) const;
+    uint64_t filterHash(View k) const;
+    bool mightContain(View k) const;
+    void rebuildFilter();
+    static int displacement(int home, int slot, const Growth& g);
+    template<class K>
+    decltype(auto) ownKey(K&& k);
+    int oldHash(View k) const;
+    template<class K>
+    void prefetch(const K* keys, int n, int* slots) const;
+    void shiftBack(int hole);
+    void migrate(int buckets);
+    static Item<T, Key>* moved();
+
     bool debug;
     int m;
-    int r[5];
+    Hash hasher;
+    Growth growth;
     int itemsInTable;
-    Item<T>** table;
-    static const int m_default[17];
-    static const int r_default[5];
+    Item<T, Key>** table;
+    // the slot iterators start from, just after an empty one, so no
+    // probe run wraps past the end of an iteration
+    int scanStart;
     T garbage;
+    // holds the bytes of ArenaString keys
+    KeyArena keyArena;
+
+    // incremental resize: the previous table and how far into it
+    // the move to table has got
+    bool incremental;
+    Item<T, Key>** oldTable;
+    int oldM;
+    Hash oldHasher;
+    Growth oldGrowth;
+    int migrated;
+    static const int migrateStep = 16;
+
+    // prefilter: filter has the keys of table, oldFilter those of
+    // oldTable that haven't been migrated yet
+    bool prefilter;
+    Hash filterHasher;
+    BlockedBloom filter;
+    BlockedBloom oldFilter;
+
+    // keys hashed and prefetched at a time by lookupMany and addMany
+    static const int batchSize = 16;
+    // slots each parallelForEach thread takes at a time
+    static const int scanChunk = 4096;
+
+#if defined(HASHTABLE_STATS)
+    mutable HashtableStats counters;
+#endif
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// forward iterator over a table's items, I being the (const) item type.
+// positions [0, m) are table's slots from scanStart round, and
+// [m, m + oldM) oldTable's
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class I>
+class Hashtable<T, Hash, Probe, Key, Growth>::Cursor {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef I value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef I* pointer;
+    typedef I& reference;
+
+    Cursor() : owner(nullptr), i(0) {}
+    I& operator*() const { return *owner->at(owner->slotAt(i)); }
+    I* operator->() const { return owner->at(owner->slotAt(i)); }
+    Cursor& operator++();
+    Cursor operator++(int);
+    bool operator==(const Cursor& other) const { return i == other.i; }
+    bool operator!=(const Cursor& other) const { return i != other.i; }
+
+private:
+    friend class Hashtable;
+    Cursor(const Hashtable* owner, int i);
+    void skip();
+
+    const Hashtable* owner;
+    int i;
 };
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-template<class T>
-Item<T>::Item(std::string k, const T& val) {
-    this->k = k;
-    this->val = val;
-}
+template<class T, class Key>
+template<class K, class... Args>
+Item<T, Key>::Item(int home, K&& k, Args&&... args)
+        : k(std::forward<K>(k)), val(std::forward<Args>(args)...), home(home) {}
 
-template<class T>
-bool Item<T>::operator==(Item other) {
+template<class T, class Key>
+bool Item<T, Key>::operator==(const Item& other) const {
     return (other.k == this->k && other.val == this->val);
 }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-// init static vars
-template<class T>
-const int Hashtable<T>::m_default[17]
-        = {11, 23, 47, 97, 197, 397, 797, 1597, 3203, 6421, 12853, 25717, 51437, 102877, 205759, 411527, 823117};
-
-template<class T>
-const int Hashtable<T>::r_default[5] = {983132572, 1468777056, 552714139, 984953261, 261934300};
-
-// constructor
-template<class T>
-Hashtable<T>::Hashtable(bool debug, unsigned int size) {
+// constructor; an incremental table grows a few buckets at a time, and
+// a prefilter table keeps a Bloom filter of its keys to turn misses away
+template<class T, class Hash, class Probe, class Key, class Growth>
+Hashtable<T, Hash, Probe, Key, Growth>::Hashtable(bool debug, unsigned int size, bool incremental, bool prefilter) {
     this->debug = debug;
-    m = size;
+    growth.setSize(size);
+    m = growth.size();
     itemsInTable = 0;
-    table = new Item<T>*[size];
-    for (unsigned int i = 0; i < size; ++i)
+    table = new Item<T, Key>*[m];
+    for (int i = 0; i < m; ++i)
         table[i] = nullptr;
+    scanStart = 0;
 
-    // set rand seed
-    srand(std::time(nullptr));
+    this->incremental = incremental;
+    oldTable = nullptr;
+    oldM = 0;
+    migrated = 0;
 
     // init r
-    if (debug) {
-        for (int i = 0; i < 5; ++i)
-            r[i] = r_default[i];
-    } else {
-        for (int i = 0; i < 5; ++i) {
-            r[i] = rand() % m;
-        }
+    hasher = Hash(debug, m);
+    garbage = T();
+
+    // the filter has its own hash, independent of the slot
+    this->prefilter = prefilter;
+    if (prefilter) {
+        filterHasher = Hash(debug, largestIntPrime);
+        filter.reset(m / 2 + 1);
     }
 }
 
 // destructor
-template<class T>
-Hashtable<T>::~Hashtable() {
+template<class T, class Hash, class Probe, class Key, class Growth>
+Hashtable<T, Hash, Probe, Key, Growth>::~Hashtable() {
     // dealloc
     for (int i = 0; i < m; ++i)
         if (table[i] != nullptr)
             delete table[i];
     delete[] table;
+
+    if (oldTable != nullptr) {
+        for (int i = 0; i < oldM; ++i)
+            if (oldTable[i] != nullptr && oldTable[i] != moved())
+                delete oldTable[i];
+        delete[] oldTable;
+    }
 }
 
-template<class T>
-int Hashtable<T>::add(std::string k, const T& val) {
-    int hashNum = hash(k);
+// returns the probe count, or 0 if k is already there with val
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+int Hashtable<T, Hash, Probe, Key, Growth>::add(K&& k, const T& val) {
+    View view = k;
+    return insert(view, hash(view),
+            [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, view) && it->val == val; },
+            [&](int home) { return new Item<T, Key>(home, ownKey(std::forward<K>(k)), val); });
+}
 
-    garbage = val;
+// moves val in, and k too if it's an rvalue
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+int Hashtable<T, Hash, Probe, Key, Growth>::add(K&& k, T&& val) {
+    View view = k;
+    return insert(view, hash(view),
+            [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, view) && it->val == val; },
+            [&](int home) { return new Item<T, Key>(home, ownKey(std::forward<K>(k)), std::move(val)); });
+}
 
-    // probe
-    int newHash = hashNum;
-    int probeCount = 0;
-    do {
-        if (table[newHash] != nullptr) {
-            // std::cout << "hash = " << newHash << std::endl;
-            if (table[newHash]->k == k && table[newHash]->val == val) {
-                return 0;
-            }
-        } else {
-            table[newHash] = new Item<T>(k, val);
-            ++itemsInTable;
-            break;
+// builds the value in place from args; unlike add, does nothing if k
+// is already in the table, since there's no value to compare yet
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K, class... Args>
+int Hashtable<T, Hash, Probe, Key, Growth>::emplace(K&& k, Args&&... args) {
+    View view = k;
+    return insert(view, hash(view),
+            [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, view); },
+            [&](int home) { return new Item<T, Key>(home, ownKey(std::forward<K>(k)), std::forward<Args>(args)...); });
+}
+
+// k's value and whether it was just added, with a value-initialized
+// value, because k wasn't in the table. Items never move, so the
+// reference is good until k is erased
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+std::pair<T&, bool> Hashtable<T, Hash, Probe, Key, Growth>::findOrInsert(K&& k) {
+    View view = k;
+    Item<T, Key>* item = nullptr;
+    bool inserted = false;
+    insert(view, hash(view),
+            [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, view); },
+            [&](int home) {
+                inserted = true;
+                return new Item<T, Key>(home, ownKey(std::forward<K>(k)));
+            },
+            &item);
+    return std::pair<T&, bool>(item->val, inserted);
+}
+
+// adds k with val, or overwrites k's value; returns whether k was added
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K, class V>
+bool Hashtable<T, Hash, Probe, Key, Growth>::insertOrAssign(K&& k, V&& val) {
+    View view = k;
+    Item<T, Key>* item = nullptr;
+    bool inserted = false;
+    insert(view, hash(view),
+            [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, view); },
+            [&](int home) {
+                inserted = true;
+                return new Item<T, Key>(home, ownKey(std::forward<K>(k)), std::forward<V>(val));
+            },
+            &item);
+    if (!inserted)
+        item->val = std::forward<V>(val);
+    return inserted;
+}
+
+// k's value, or a value-initialized T if it's missing
+template<class T, class Hash, class Probe, class Key, class Growth>
+const T& Hashtable<T, Hash, Probe, Key, Growth>::lookup(View k) {
+    if (oldTable != nullptr)
+        migrate(migrateStep);
+
+    return get(k, hash(k));
+}
+
+// whether k is in the table, without touching its value
+template<class T, class Hash, class Probe, class Key, class Growth>
+bool Hashtable<T, Hash, Probe, Key, Growth>::contains(View k) {
+    if (oldTable != nullptr)
+        migrate(migrateStep);
+
+    return locate(k, hash(k)) >= 0;
+}
+
+// an iterator to k's item, or end(); unlike lookup it tells a miss from
+// a value-initialized value, and the item can be changed through it
+template<class T, class Hash, class Probe, class Key, class Growth>
+typename Hashtable<T, Hash, Probe, Key, Growth>::iterator Hashtable<T, Hash, Probe, Key, Growth>::find(View k) {
+    if (oldTable != nullptr)
+        migrate(migrateStep);
+
+    int i = locate(k, hash(k));
+    return i >= 0 ? iterator(this, positionOf(i)) : end();
+}
+
+// out[i] = lookup(keys[i]); each batch is hashed and prefetched before
+// any of it is probed, so the misses overlap
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+void Hashtable<T, Hash, Probe, Key, Growth>::lookupMany(const K* keys, int n, T* out) {
+    int slots[batchSize];
+    for (int i = 0; i < n; i += batchSize) {
+        int batch = n - i < batchSize ? n - i : batchSize;
+        prefetch(keys + i, batch, slots);
+
+        int size = m;
+        for (int j = 0; j < batch; ++j) {
+            View k = keys[i + j];
+            if (oldTable != nullptr)
+                migrate(migrateStep);
+            // a resize moves every home slot
+            out[i + j] = get(k, m == size ? slots[j] : hash(k));
         }
-        newHash = (hashNum + (int)pow(++probeCount, 2)) % m;
-    } while (table[newHash] != nullptr);
+    }
+}
 
-    if ((itemsInTable + 1) / m > 0.5)
-        resize();
+// add(keys[i], vals[i]) for each i, storing the results in out if given
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+void Hashtable<T, Hash, Probe, Key, Growth>::addMany(const K* keys, const T* vals, int n, int* out) {
+    int slots[batchSize];
+    for (int i = 0; i < n; i += batchSize) {
+        int batch = n - i < batchSize ? n - i : batchSize;
+        prefetch(keys + i, batch, slots);
 
-    return probeCount;
+        int size = m;
+        for (int j = 0; j < batch; ++j) {
+            View view = keys[i + j];
+            const T& val = vals[i + j];
+            int probeCount = insert(view, m == size ? slots[j] : hash(view),
+                    [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, view) && it->val == val; },
+                    [&](int home) { return new Item<T, Key>(home, ownKey(keys[i + j]), val); });
+            if (out != nullptr)
+                out[i + j] = probeCount;
+        }
+    }
 }
 
-template<class T>
-const T& Hashtable<T>::lookup(std::string k) {
+// removes every item with key k; returns whether there were any. The
+// rest of the probe run shifts back, so no tombstones are left
+template<class T, class Hash, class Probe, class Key, class Growth>
+bool Hashtable<T, Hash, Probe, Key, Growth>::erase(View k) {
+    static_assert(Probe::linear, "erase needs a linear probe (LinearProbe or RobinHoodProbe)");
+
+    if (oldTable != nullptr)
+        migrate(migrateStep);
+
+    auto same = [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, k); };
+    bool erased = false;
     int hashNum = hash(k);
+    int slot;
+    while ((slot = search(hashNum, same, table, growth, Probe::robinHood)) >= 0) {
+        delete table[slot];
+        table[slot] = nullptr;
+        --itemsInTable;
+        shiftBack(slot);
+        erased = true;
+    }
 
-    // probe
-    int newHash = hashNum;
-    int probeCount = 0;
-    while (table[newHash] != NULL) {
-        if (table[newHash] != NULL) {
-            if (table[newHash]->k == k)
-                return table[newHash]->val;
-        }
-        else break;
-        newHash = (hashNum + (int)pow(++probeCount, 2)) % m;
+    // the old table is on its way out, so a marker will do there
+    hashNum = oldTable != nullptr ? oldHash(k) : 0;
+    while (oldTable != nullptr && (slot = search(hashNum, same, oldTable, oldGrowth, false)) >= 0) {
+        delete oldTable[slot];
+        oldTable[slot] = moved();
+        --itemsInTable;
+        erased = true;
+    }
+
+    return erased;
+}
+
+// removes the item it points at and returns an iterator to the next
+// one, which may be an item shifted back into its slot. Iterating from
+// scanStart, the shift only moves items the loop hasn't reached yet,
+// so erasing while iterating visits every other item exactly once.
+// Other iterators may no longer point at an item
+template<class T, class Hash, class Probe, class Key, class Growth>
+typename Hashtable<T, Hash, Probe, Key, Growth>::iterator Hashtable<T, Hash, Probe, Key, Growth>::erase(iterator it) {
+    static_assert(Probe::linear, "erase needs a linear probe (LinearProbe or RobinHoodProbe)");
+
+    int i = it.i;
+    if (i < m) {
+        int slot = slotAt(i);
+        delete table[slot];
+        table[slot] = nullptr;
+        shiftBack(slot);
+    } else {
+        delete oldTable[i - m];
+        oldTable[i - m] = moved();
+        ++i;
     }
+    --itemsInTable;
+
+    return iterator(this, i);
+}
 
-    return garbage;
+// starts just after an empty slot, moving scanStart on if an add has
+// filled the one before it. Erasing never fills a slot, so it stays
+// put while a loop erases; anything else that moves items invalidates
+// iterators
+template<class T, class Hash, class Probe, class Key, class Growth>
+typename Hashtable<T, Hash, Probe, Key, Growth>::iterator Hashtable<T, Hash, Probe, Key, Growth>::begin() {
+    int before = scanStart > 0 ? scanStart - 1 : m - 1;
+    for (int n = 0; n < m && table[before] != nullptr; ++n)
+        before = before + 1 < m ? before + 1 : 0;
+    scanStart = before + 1 < m ? before + 1 : 0;
+    return iterator(this, 0);
 }
 
-template<class T>
-void Hashtable<T>::reportAll(std::ostream& out) const {
+template<class T, class Hash, class Probe, class Key, class Growth>
+void Hashtable<T, Hash, Probe, Key, Growth>::reportAll(std::ostream& out) const {
     for (int i = 0; i < m; ++i) {
         if (table[i] != NULL)
             out << table[i]->k << ' ' << table[i]->val << std::endl;
     }
+    for (int i = 0; i < oldM && oldTable != nullptr; ++i) {
+        if (oldTable[i] != nullptr && oldTable[i] != moved())
+            out << oldTable[i]->k << ' ' << oldTable[i]->val << std::endl;
+    }
+}
+
+// calls fn(item) for every item, from up to threads threads at once, so
+// fn must be safe to run in parallel. Each thread takes the next
+// scanChunk slots until there are none left
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class Fn>
+void Hashtable<T, Hash, Probe, Key, Growth>::parallelForEach(Fn fn, int threads) {
+    int slots = m + oldM;
+    int chunks = (slots + scanChunk - 1) / scanChunk;
+    if (threads < 1)
+        threads = 1;
+    if (threads > chunks)
+        threads = chunks;
+
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        int c;
+        while ((c = next++) < chunks) {
+            int end = (c + 1) * scanChunk < slots ? (c + 1) * scanChunk : slots;
+            for (int i = c * scanChunk; i < end; ++i) {
+                Item<T, Key>* item = at(i);
+                if (item != nullptr)
+                    fn(*item);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i)
+        workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+// measures the table now, on top of whatever the counters have seen
+template<class T, class Hash, class Probe, class Key, class Growth>
+HashtableStats Hashtable<T, Hash, Probe, Key, Growth>::stats() const {
+    HashtableStats s;
+#if defined(HASHTABLE_STATS)
+    s.loadCounters(counters);
+#endif
+    s.size = m;
+    s.items = itemsInTable;
+    s.loadFactor = (double)itemsInTable / m;
+    s.bytesAllocated = sizeof(Item<T, Key>*) * (m + oldM) + sizeof(Item<T, Key>) * itemsInTable + keyArena.bytes()
+            + filter.bytes() + oldFilter.bytes();
+
+    for (int i = 0; i < m; ++i)
+        if (table[i] != nullptr) {
+            int d = displacement(table[i]->home, i, growth);
+            if (d > s.maxDisplacement)
+                s.maxDisplacement = d;
+        }
+    for (int i = 0; i < oldM && oldTable != nullptr; ++i)
+        if (oldTable[i] != nullptr && oldTable[i] != moved()) {
+            int d = displacement(oldTable[i]->home, i, oldGrowth);
+            if (d > s.maxDisplacement)
+                s.maxDisplacement = d;
+        }
+
+    return s;
+}
+
+// writes a snapshot (see MappedHashtable.h); values and the hash and
+// growth policies are copied as raw bytes. returns false if the file
+// couldn't be written
+template<class T, class Hash, class Probe, class Key, class Growth>
+bool Hashtable<T, Hash, Probe, Key, Growth>::save(const char* path) {
+    static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Hash>::value && std::is_trivially_copyable<Growth>::value,
+            "snapshot hash and growth policies must be trivially copyable");
+
+    // a snapshot holds a single table
+    if (oldTable != nullptr)
+        migrate(oldM);
+
+    MappedHeader header;
+    memcpy(header.magic, MappedHeader::magic_default, sizeof(header.magic));
+    header.m = m;
+    header.items = itemsInTable;
+    header.slotSize = sizeof(MappedSlot<T>);
+    header.valSize = sizeof(T);
+    header.hashSize = sizeof(Hash);
+    header.growthSize = sizeof(Growth);
+    header.hashOffset = MappedHeader::alignUp(sizeof(MappedHeader));
+    header.growthOffset = MappedHeader::alignUp(header.hashOffset + sizeof(Hash));
+    header.slotsOffset = MappedHeader::alignUp(header.growthOffset + sizeof(Growth));
+    header.arenaOffset = MappedHeader::alignUp(header.slotsOffset + (uint64_t)m * sizeof(MappedSlot<T>));
+    header.arenaSize = 0;
+    for (int i = 0; i < m; ++i)
+        if (table[i] != nullptr) {
+            const View& k = table[i]->k;
+            header.arenaSize += mappedBytes(k).size();
+        }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    uint64_t pos = 0;
+    auto write = [&](const void* p, uint64_t n) {
+        file.write((const char*)p, n);
+        pos += n;
+    };
+    auto padTo = [&](uint64_t offset) {
+        static const char zeros[MappedHeader::align] = {};
+        write(zeros, offset - pos);
+    };
+
+    write(&header, sizeof(header));
+    padTo(header.hashOffset);
+    write(&hasher, sizeof(Hash));
+    padTo(header.growthOffset);
+    write(&growth, sizeof(Growth));
+    padTo(header.slotsOffset);
+
+    // slots, with each key's place in the arena
+    uint64_t keyOffset = 0;
+    for (int i = 0; i < m; ++i) {
+        MappedSlot<T> slot{};
+        slot.home = -1;
+        if (table[i] != nullptr) {
+            const View& k = table[i]->k;
+            std::string_view bytes = mappedBytes(k);
+            slot.keyOffset = keyOffset;
+            slot.keyLength = bytes.size();
+            slot.home = table[i]->home;
+            slot.val = table[i]->val;
+            keyOffset += bytes.size();
+        }
+        write(&slot, sizeof(slot));
+    }
+    padTo(header.arenaOffset);
+
+    // the keys themselves, in slot order
+    for (int i = 0; i < m; ++i)
+        if (table[i] != nullptr) {
+            const View& k = table[i]->k;
+            std::string_view bytes = mappedBytes(k);
+            write(bytes.data(), bytes.size());
+        }
+
+    file.close();
+    return !file.fail();
 }
 
-template<class T>
-void Hashtable<T>::resize() {
+// maps a snapshot from save back in as a read only table
+template<class T, class Hash, class Probe, class Key, class Growth>
+MappedHashtable<T, Hash, Probe, Key, Growth> Hashtable<T, Hash, Probe, Key, Growth>::openMapped(const char* path) {
+    return MappedHashtable<T, Hash, Probe, Key, Growth>(path);
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+void Hashtable<T, Hash, Probe, Key, Growth>::resize() {
+#if defined(HASHTABLE_STATS)
+    HashtableStats::ResizeTimer timer(counters);
+#endif
+
+    // finish moving out of the last table first
+    if (oldTable != nullptr)
+        migrate(oldM);
 
     // find new size
-    int newSize = 0;
     int oldSize = m;
-    for (int i = 0; i < 17; ++i)
-        if (m < m_default[i])
-            newSize = m_default[i];
+    Growth prevGrowth = growth;
+    growth.setSize(growth.grow());
+    int newSize = growth.size();
 
     // new table, swap tables
-    Item<T>** newTable = new Item<T>*[newSize];
+    Item<T, Key>** newTable = new Item<T, Key>*[newSize];
     for (int i = 0; i < newSize; ++i)
         newTable[i] = nullptr;
-    Item<T>** oldTable = table;
+    Item<T, Key>** prevTable = table;
     table = newTable;
     m = newSize;
+    scanStart = 0;
+
+    // leave the items where they are for now, migrate moves them
+    if (incremental) {
+        oldTable = prevTable;
+        oldM = oldSize;
+        oldHasher = hasher;
+        oldGrowth = prevGrowth;
+        migrated = 0;
+        hasher.reseed(m);
+        // migrate adds the items to the new filter as it moves them
+        if (prefilter) {
+            oldFilter.swap(filter);
+            filter.reset(m / 2 + 1);
+        }
+        return;
+    }
 
     // gen new r vals
-    if (!debug)
-        for (int i = 0; i < 5; ++i)
-            r[i] = rand() % m;
+    hasher.reseed(m);
 
-    // re-hash
+    // re-hash, moving the existing items over
     itemsInTable = 0;
-    int trash;
     for (int i = 0; i < oldSize; ++i)
-        if (oldTable[i] != nullptr) {
-            trash = add(oldTable[i]->k, oldTable[i]->val);
-            delete oldTable[i];
+        if (prevTable[i] != nullptr) {
+            Item<T, Key>* item = prevTable[i];
+            place(item->k, hash(item->k),
+                    [](const Item<T, Key>*) { return false; },
+                    [item](int home) { item->home = home; return item; });
         }
 
-    // get rid of warnings
-    if (trash < 0)
-        trash = 0;
-
     // dealloc
-    delete[] oldTable;
+    delete[] prevTable;
+
+    if (prefilter)
+        rebuildFilter();
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+int Hashtable<T, Hash, Probe, Key, Growth>::hash(View k) const {
+    return growth.reduce(hasher(k));
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+void Hashtable<T, Hash, Probe, Key, Growth>::hashMany(const K* keys, int n, int* out) const {
+    unsigned long long codes[64];
+    for (int i = 0; i < n; i += 64) {
+        int batch = n - i < 64 ? n - i : 64;
+        hasher.hashMany(keys + i, batch, codes);
+        for (int j = 0; j < batch; ++j)
+            out[i + j] = growth.reduce(codes[j]);
+    }
+}
+
+// add k, whose home slot is hashNum, checking the table being migrated
+// for duplicates too. at, if given, is set to the matching or new item
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class Same, class Make>
+int Hashtable<T, Hash, Probe, Key, Growth>::insert(View k, int hashNum, Same same, Make make, Item<T, Key>** at) {
+    if (oldTable != nullptr) {
+        int size = m;
+        migrate(migrateStep);
+        // moving an item can (rarely) resize, which moves k's home
+        if (m != size)
+            hashNum = hash(k);
+        int slot = oldTable != nullptr ? search(oldHash(k), same, oldTable, oldGrowth, false) : -1;
+        if (slot >= 0) {
+            if (at != nullptr)
+                *at = oldTable[slot];
+            return 0;
+        }
+    }
+
+    // hashed before make can move the key out from under k; a duplicate
+    // just sets bits that are already set
+    uint64_t filterCode = prefilter ? filterHash(k) : 0;
+    int probeCount = place(k, hashNum, same, make, at);
+    if (prefilter)
+        filter.insert(filterCode);
+
+    if ((double)(itemsInTable + 1) / m > 0.5)
+        resize();
+
+    return probeCount;
 }
 
-template<class T>
-int Hashtable<T>::hash(std::string k) const {
-    long long w[5];
-    int letterCount = k.size() - 1;
-    long temp;
-    for (int i = 4; i >= 0; --i) {
-        temp = 0;
-        for (int j = 5; j >= 0; --j) {
-            if (letterCount >= 0)
-                temp += (long long)pow(27, 5 - j) * (long long)((long long)k[letterCount--] - 'a' + 1);
+// probes for k; returns 0 if same() matches an item on the way, or
+// else stores the item from make(home) and returns its probe count.
+// with robin hood probing the new item may take over a slot partway,
+// after which the displaced item is the one being placed. at, if given,
+// is set to the matching or new item
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class Same, class Make>
+int Hashtable<T, Hash, Probe, Key, Growth>::place(View k, int hashNum, Same same, Make make, Item<T, Key>** at) {
+    // probe
+    Item<T, Key>* item = nullptr;
+    int home = hashNum;
+    int newHash = hashNum;
+    int probeCount = 0;
+    int result = -1;
+    while (table[newHash] != nullptr) {
+        if (item == nullptr && same(table[newHash])) {
+            if (at != nullptr)
+                *at = table[newHash];
+            return 0;
         }
-        w[i] = temp;
+        if constexpr (Probe::robinHood) {
+            int theirs = Probe::distance(table[newHash]->home, newHash, m);
+            if (theirs < probeCount) {
+                if (item == nullptr) {
+                    item = make(home);
+                    result = probeCount;
+                    if (at != nullptr)
+                        *at = item;
+                }
+                std::swap(item, table[newHash]);
+                home = item->home;
+                probeCount = theirs;
+            }
+        }
+        if (++probeCount == m && item == nullptr) {
+            // the sequence never reached an empty slot
+            resize();
+            return place(k, hash(k), same, make, at);
+        }
+        newHash = Probe::next(home, probeCount, growth);
     }
 
-    long long hashNum = 0;
-    for (int i = 0; i < 5; ++i) {
-        hashNum += (long long)r[i] * (long long)w[i];
-        // std::cout << "  " << w[i] << std::endl;
+    if (item == nullptr) {
+        item = make(home);
+        result = probeCount;
+        if (at != nullptr)
+            *at = item;
     }
-    hashNum = hashNum % m;
+    table[newHash] = item;
+    ++itemsInTable;
+
+    return result;
+}
+
+// probes tbl from hashNum for the first item matching same() and
+// returns its slot, or -1; robin hood tables can stopEarly once the
+// key would have displaced an item
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class Same>
+int Hashtable<T, Hash, Probe, Key, Growth>::search(int hashNum, Same same, Item<T, Key>** tbl, const Growth& g, bool stopEarly, int* probes) const {
+    int size = g.size();
+
+    // probe
+    int newHash = hashNum;
+    int probeCount = 0;
+    int slot = -1;
+    while (tbl[newHash] != nullptr) {
+        if (tbl[newHash] != moved() && same(tbl[newHash])) {
+            slot = newHash;
+            break;
+        }
+        if constexpr (Probe::robinHood) {
+            if (stopEarly && Probe::distance(tbl[newHash]->home, newHash, size) < probeCount)
+                break;
+        }
+        if (++probeCount == size)
+            break;
+        newHash = Probe::next(hashNum, probeCount, g);
+    }
+
+    if (probes != nullptr)
+        *probes += probeCount;
+    return slot;
+}
+
+// lookup without the migration step, k's home slot being hashNum
+template<class T, class Hash, class Probe, class Key, class Growth>
+const T& Hashtable<T, Hash, Probe, Key, Growth>::get(View k, int hashNum) const {
+    int i = locate(k, hashNum);
+    return i >= 0 ? at(i)->val : garbage;
+}
+
+// k's slot, counting oldTable's slots as coming after table's (see
+// at), or -1; the prefilter turns most misses away before they probe
+template<class T, class Hash, class Probe, class Key, class Growth>
+int Hashtable<T, Hash, Probe, Key, Growth>::locate(View k, int hashNum) const {
+    if (prefilter && !mightContain(k)) {
+#if defined(HASHTABLE_STATS)
+        counters.recordMiss(0);
+#endif
+        return -1;
+    }
+
+    auto same = [&](const Item<T, Key>* it) { return KeyTraits<Key>::equal(it->k, k); };
+    int probes = 0;
+    int i = search(hashNum, same, table, growth, Probe::robinHood, &probes);
+    if (i < 0 && oldTable != nullptr && (i = search(oldHash(k), same, oldTable, oldGrowth, false, &probes)) >= 0)
+        i += m;
+
+#if defined(HASHTABLE_STATS)
+    if (i >= 0)
+        counters.recordHit(probes);
+    else
+        counters.recordMiss(probes);
+#endif
+
+    return i;
+}
+
+// the item in slot i of table followed by oldTable, or nullptr
+template<class T, class Hash, class Probe, class Key, class Growth>
+Item<T, Key>* Hashtable<T, Hash, Probe, Key, Growth>::at(int i) const {
+    Item<T, Key>* item = i < m ? table[i] : oldTable[i - m];
+    return item != moved() ? item : nullptr;
+}
+
+// table's slot at iterator position pos, or pos itself in oldTable
+template<class T, class Hash, class Probe, class Key, class Growth>
+int Hashtable<T, Hash, Probe, Key, Growth>::slotAt(int pos) const {
+    if (pos >= m)
+        return pos;
+    return pos + scanStart < m ? pos + scanStart : pos + scanStart - m;
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+int Hashtable<T, Hash, Probe, Key, Growth>::positionOf(int slot) const {
+    if (slot >= m)
+        return slot;
+    return slot >= scanStart ? slot - scanStart : slot + m - scanStart;
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+uint64_t Hashtable<T, Hash, Probe, Key, Growth>::filterHash(View k) const {
+    return mix64(filterHasher(k));
+}
+
+// false if k is in neither filter, so can't be in the table
+template<class T, class Hash, class Probe, class Key, class Growth>
+bool Hashtable<T, Hash, Probe, Key, Growth>::mightContain(View k) const {
+    uint64_t h = filterHash(k);
+    return filter.mayContain(h) || (oldTable != nullptr && oldFilter.mayContain(h));
+}
+
+// refills the filter from the items in table, dropping erased keys
+template<class T, class Hash, class Probe, class Key, class Growth>
+void Hashtable<T, Hash, Probe, Key, Growth>::rebuildFilter() {
+    filter.reset(m / 2 + 1);
+    oldFilter.reset(0);
+    for (int i = 0; i < m; ++i)
+        if (table[i] != nullptr)
+            filter.insert(filterHash(table[i]->k));
+}
+
+// the key to build an item from; arena keys are copied into keyArena
+// first, anything else is passed on as it came
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+decltype(auto) Hashtable<T, Hash, Probe, Key, Growth>::ownKey(K&& k) {
+    if constexpr (KeyTraits<Key>::arena)
+        return Key(keyArena.store(View(k)));
+    else
+        return std::forward<K>(k);
+}
+
+// probe steps from home to slot
+template<class T, class Hash, class Probe, class Key, class Growth>
+int Hashtable<T, Hash, Probe, Key, Growth>::displacement(int home, int slot, const Growth& g) {
+    int i = 0;
+    while (Probe::next(home, i, g) != slot && i < g.size())
+        ++i;
+    return i;
+}
+
+// k's home slot in the table being migrated
+template<class T, class Hash, class Probe, class Key, class Growth>
+int Hashtable<T, Hash, Probe, Key, Growth>::oldHash(View k) const {
+    return oldGrowth.reduce(oldHasher(k));
+}
+
+// hashes a batch of keys to their home slots, then starts loading the
+// slots and the items in them so all the misses are in flight at once
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+void Hashtable<T, Hash, Probe, Key, Growth>::prefetch(const K* keys, int n, int* slots) const {
+    hashMany(keys, n, slots);
+    for (int j = 0; j < n; ++j)
+        __builtin_prefetch(&table[slots[j]]);
+    for (int j = 0; j < n; ++j)
+        if (table[slots[j]] != nullptr)
+            __builtin_prefetch(table[slots[j]]);
+}
+
+// fills an emptied slot with the items after it in its probe run, each
+// moving back as long as that doesn't put it before its home slot
+template<class T, class Hash, class Probe, class Key, class Growth>
+void Hashtable<T, Hash, Probe, Key, Growth>::shiftBack(int hole) {
+    int i = hole;
+    while (true) {
+        i = Probe::next(i, 1, growth);
+        Item<T, Key>* item = table[i];
+        if (item == nullptr)
+            break;
+        if (Probe::distance(item->home, hole, m) < Probe::distance(item->home, i, m)) {
+            table[hole] = item;
+            table[i] = nullptr;
+            hole = i;
+        } else if constexpr (Probe::robinHood) {
+            // it's at home, and so is everything else in the run
+            break;
+        }
+    }
+}
+
+// moves up to the next few buckets of oldTable into table, and lets go
+// of oldTable once it's empty
+template<class T, class Hash, class Probe, class Key, class Growth>
+void Hashtable<T, Hash, Probe, Key, Growth>::migrate(int buckets) {
+    int end = migrated + buckets;
+    while (oldTable != nullptr && migrated < end && migrated < oldM) {
+        int i = migrated++;
+        Item<T, Key>* item = oldTable[i];
+        if (item == nullptr || item == moved())
+            continue;
+        oldTable[i] = moved();
+        --itemsInTable;
+        place(item->k, hash(item->k),
+                [](const Item<T, Key>*) { return false; },
+                [item](int home) { item->home = home; return item; });
+        if (prefilter)
+            filter.insert(filterHash(item->k));
+    }
+
+    if (oldTable != nullptr && migrated == oldM) {
+        delete[] oldTable;
+        oldTable = nullptr;
+        oldM = 0;
+        oldFilter.reset(0);
+    }
+}
+
+// marks a slot of oldTable whose item has been moved to table; it still
+// counts as occupied so the probe sequences through it stay intact
+template<class T, class Hash, class Probe, class Key, class Growth>
+Item<T, Key>* Hashtable<T, Hash, Probe, Key, Growth>::moved() {
+    static char marker;
+    return reinterpret_cast<Item<T, Key>*>(&marker);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class I>
+Hashtable<T, Hash, Probe, Key, Growth>::Cursor<I>::Cursor(const Hashtable* owner, int i) : owner(owner), i(i) {
+    skip();
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class I>
+typename Hashtable<T, Hash, Probe, Key, Growth>::template Cursor<I>& Hashtable<T, Hash, Probe, Key, Growth>::Cursor<I>::operator++() {
+    ++i;
+    skip();
+    return *this;
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class I>
+typename Hashtable<T, Hash, Probe, Key, Growth>::template Cursor<I> Hashtable<T, Hash, Probe, Key, Growth>::Cursor<I>::operator++(int) {
+    Cursor was = *this;
+    ++*this;
+    return was;
+}
+
+// moves on to the next occupied slot, or the end
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class I>
+void Hashtable<T, Hash, Probe, Key, Growth>::Cursor<I>::skip() {
+    int end = owner->m + owner->oldM;
+    while (i < end && owner->at(owner->slotAt(i)) == nullptr)
+        ++i;
+}
 
-    return hashNum;
-}
\ No newline at end of file
+#endif
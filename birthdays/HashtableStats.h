@@ -0,0 +1,119 @@
+#ifndef HASHTABLESTATS_H
+#define HASHTABLESTATS_H
+
+#include <chrono>
+#include <iostream>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * A snapshot of a table's health, from Hashtable::stats().
+ *
+ * The shape of the table (size, load, displacement, memory) is measured
+ * when stats() is called, so it's always available. The counters of
+ * what the table has done (probe lengths of lookups, resizes) are only
+ * kept when compiled with -DHASHTABLE_STATS; otherwise enabled is false,
+ * they stay 0, and counting costs nothing. Probe lengths are counted
+ * with relaxed atomic adds, since lookups only read the table and may
+ * run on several threads at once.
+ */
+struct HashtableStats {
+    // counts a resize and adds its time once it goes out of scope
+    class ResizeTimer {
+    public:
+        ResizeTimer(HashtableStats& stats);
+        ~ResizeTimer();
+
+    private:
+        HashtableStats& stats;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    HashtableStats();
+    void recordHit(int probes);
+    void recordMiss(int probes);
+    void loadCounters(const HashtableStats& from);
+    void writeJson(std::ostream& out) const;
+
+#if defined(HASHTABLE_STATS)
+    static const bool enabled = true;
+#else
+    static const bool enabled = false;
+#endif
+
+    // the last bucket counts every probe length from buckets - 1 up
+    static const int buckets = 32;
+
+    int size;
+    int items;
+    double loadFactor;
+    // most slots any item sits past its home, in probe steps
+    int maxDisplacement;
+    // slot arrays and items (not what keys allocate themselves)
+    unsigned long long bytesAllocated;
+
+    unsigned long long hitProbes[buckets];
+    unsigned long long missProbes[buckets];
+    int resizes;
+    double resizeSeconds;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+inline HashtableStats::ResizeTimer::ResizeTimer(HashtableStats& stats) : stats(stats) {
+    ++stats.resizes;
+    start = std::chrono::steady_clock::now();
+}
+
+inline HashtableStats::ResizeTimer::~ResizeTimer() {
+    stats.resizeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// constructor
+inline HashtableStats::HashtableStats()
+        : size(0), items(0), loadFactor(0), maxDisplacement(0), bytesAllocated(0), hitProbes(), missProbes(),
+          resizes(0), resizeSeconds(0) {}
+
+inline void HashtableStats::recordHit(int probes) {
+    __atomic_fetch_add(&hitProbes[probes < buckets ? probes : buckets - 1], 1, __ATOMIC_RELAXED);
+}
+
+inline void HashtableStats::recordMiss(int probes) {
+    __atomic_fetch_add(&missProbes[probes < buckets ? probes : buckets - 1], 1, __ATOMIC_RELAXED);
+}
+
+// copies what from has counted, reading the probe counts atomically so
+// lookups can keep counting meanwhile
+inline void HashtableStats::loadCounters(const HashtableStats& from) {
+    for (int i = 0; i < buckets; ++i) {
+        hitProbes[i] = __atomic_load_n(&from.hitProbes[i], __ATOMIC_RELAXED);
+        missProbes[i] = __atomic_load_n(&from.missProbes[i], __ATOMIC_RELAXED);
+    }
+    resizes = from.resizes;
+    resizeSeconds = from.resizeSeconds;
+}
+
+inline void HashtableStats::writeJson(std::ostream& out) const {
+    out << "{\"enabled\": " << (enabled ? "true" : "false")
+        << ", \"size\": " << size
+        << ", \"items\": " << items
+        << ", \"loadFactor\": " << loadFactor
+        << ", \"maxDisplacement\": " << maxDisplacement
+        << ", \"bytesAllocated\": " << bytesAllocated
+        << ", \"resizes\": " << resizes
+        << ", \"resizeSeconds\": " << resizeSeconds;
+
+    out << ", \"hitProbes\": [";
+    for (int i = 0; i < buckets; ++i)
+        out << (i ? ", " : "") << hitProbes[i];
+    out << "], \"missProbes\": [";
+    for (int i = 0; i < buckets; ++i)
+        out << (i ? ", " : "") << missProbes[i];
+    out << "]}" << std::endl;
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef KEYARENA_H
+#define KEYARENA_H
+
+#include "HashPolicies.h"
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Bump allocator for key bytes. store() copies a key to the end of the
+ * current block and starts a new block when that one is full. Nothing
+ * is freed on its own; the blocks all go at once with the arena.
+ */
+class KeyArena {
+public:
+    KeyArena();
+    KeyArena(const KeyArena&) = delete;
+    KeyArena& operator=(const KeyArena&) = delete;
+    ~KeyArena();
+    std::string_view store(std::string_view k);
+    size_t bytes() const { return allocated; }
+
+private:
+    static const size_t blockSize = 64 * 1024;
+
+    std::vector<char*> blocks;
+    char* next;
+    size_t left;
+    size_t allocated;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// a string key whose bytes live in the table's KeyArena, so items don't
+// each allocate their key. Erasing an item leaves its bytes in the arena
+// until the table goes
+struct ArenaString : std::string_view {
+    ArenaString(std::string_view s) : std::string_view(s) {}
+};
+
+template<>
+struct KeyTraits<ArenaString> {
+    typedef std::string_view View;
+    static const bool arena = true;
+    static bool equal(const ArenaString& a, std::string_view b) { return std::string_view(a) == b; }
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+inline KeyArena::KeyArena() {
+    next = nullptr;
+    left = 0;
+    allocated = 0;
+}
+
+// destructor
+inline KeyArena::~KeyArena() {
+    // dealloc
+    for (char* block : blocks)
+        delete[] block;
+}
+
+inline std::string_view KeyArena::store(std::string_view k) {
+    if (k.size() > left) {
+        // keys bigger than a block get a block to themselves
+        size_t size = k.size() > blockSize ? k.size() : blockSize;
+        next = new char[size];
+        left = size;
+        allocated += size;
+        blocks.push_back(next);
+    }
+
+    char* copy = next;
+    if (!k.empty())
+        memcpy(copy, k.data(), k.size());
+    next += k.size();
+    left -= k.size();
+    return std::string_view(copy, k.size());
+}
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef MAPPEDHASHTABLE_H
+#define MAPPEDHASHTABLE_H
+
+#include "HashPolicies.h"
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * The snapshot file Hashtable::save writes:
+ *
+ *   header | hasher | growth | slots | key arena
+ *
+ * Every section starts on a 64 byte boundary and is found through an
+ * offset in the header, so nothing in the file is a pointer. The hasher
+ * and growth policy are copied byte for byte (seeds, precomputed
+ * tables and all), so a mapped table probes exactly the slots the
+ * saved one did. The sizes in the header are checked when the file is
+ * opened, so a snapshot from a different build of the table is turned
+ * away instead of misread, and every key is checked against the arena
+ * as a lookup reads it, so a corrupt slot only misses.
+ */
+struct MappedHeader {
+    char magic[8];
+    uint64_t m;
+    uint64_t items;
+    uint64_t slotSize;
+    uint64_t valSize;
+    uint64_t hashSize;
+    uint64_t growthSize;
+    uint64_t hashOffset;
+    uint64_t growthOffset;
+    uint64_t slotsOffset;
+    uint64_t arenaOffset;
+    uint64_t arenaSize;
+
+    static constexpr char magic_default[8] = {'H', 'T', 'S', 'N', 'A', 'P', '1', '\0'};
+    static const uint64_t align = 64;
+    static uint64_t alignUp(uint64_t offset) { return (offset + align - 1) & ~(align - 1); }
+    // whether size bytes from offset stay within limit, without overflowing
+    static bool fits(uint64_t offset, uint64_t size, uint64_t limit) { return offset <= limit && size <= limit - offset; }
+};
+
+// one slot of the table; empty slots have a home of -1
+template<class T>
+struct MappedSlot {
+    uint64_t keyOffset;
+    uint32_t keyLength;
+    int32_t home;
+    T val;
+};
+
+// the bytes a key is stored as: string keys as their characters, any
+// other (trivially copyable) key as itself
+inline std::string_view mappedBytes(std::string_view k);
+template<class K>
+std::string_view mappedBytes(const K& k);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * A read only Hashtable served straight out of a snapshot file (see
+ * Hashtable::save and Hashtable::openMapped). Opening maps the file and
+ * reads the header; nothing is parsed or rebuilt, and pages are only
+ * read from disk as lookups touch them, so even a huge table is ready
+ * at once.
+ *
+ * Check isOpen() after opening; a missing, truncated or mismatched file
+ * leaves the table closed, and every lookup misses.
+ */
+template<class T, class Hash = UniversalHash, class Probe = QuadraticProbe, class Key = std::string,
+        class Growth = PrimeGrowth>
+class MappedHashtable {
+public:
+    typedef typename KeyTraits<Key>::View View;
+
+    MappedHashtable(const char* path);
+    MappedHashtable(MappedHashtable&& other);
+    MappedHashtable(const MappedHashtable&) = delete;
+    MappedHashtable& operator=(const MappedHashtable&) = delete;
+    ~MappedHashtable();
+    bool isOpen() const { return base != nullptr; }
+    const T& lookup(View k) const;
+    int size() const { return m; }
+    int items() const { return itemsInTable; }
+
+private:
+    void close();
+
+    char* base;
+    size_t length;
+    int m;
+    int itemsInTable;
+    Hash hasher;
+    Growth growth;
+    const MappedSlot<T>* slots;
+    const char* arena;
+    uint64_t arenaSize;
+    T garbage;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+inline std::string_view mappedBytes(std::string_view k) {
+    return k;
+}
+
+template<class K>
+std::string_view mappedBytes(const K& k) {
+    static_assert(std::is_trivially_copyable<K>::value, "snapshot keys must be strings or trivially copyable");
+    return std::string_view((const char*)&k, sizeof(K));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<class T, class Hash, class Probe, class Key, class Growth>
+MappedHashtable<T, Hash, Probe, Key, Growth>::MappedHashtable(const char* path) : garbage() {
+    base = nullptr;
+    length = 0;
+    m = 0;
+    itemsInTable = 0;
+    slots = nullptr;
+    arena = nullptr;
+    arenaSize = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(MappedHeader)) {
+        length = st.st_size;
+        void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+            base = static_cast<char*>(p);
+    }
+    ::close(fd);
+    if (base == nullptr)
+        return;
+
+    // make sure it's a snapshot of this kind of table, and all there
+    MappedHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, MappedHeader::magic_default, sizeof(header.magic)) != 0
+            || header.slotSize != sizeof(MappedSlot<T>) || header.valSize != sizeof(T) || header.hashSize != sizeof(Hash)
+            || header.growthSize != sizeof(Growth) || !MappedHeader::fits(header.arenaOffset, header.arenaSize, length)
+            || header.m > length / sizeof(MappedSlot<T>) || header.m > INT_MAX || header.items > header.m
+            || header.slotsOffset % MappedHeader::align != 0
+            || !MappedHeader::fits(header.slotsOffset, header.m * sizeof(MappedSlot<T>), header.arenaOffset)
+            || !MappedHeader::fits(header.hashOffset, sizeof(Hash), length)
+            || !MappedHeader::fits(header.growthOffset, sizeof(Growth), length)) {
+        close();
+        return;
+    }
+
+    m = header.m;
+    itemsInTable = header.items;
+    memcpy((void*)&hasher, base + header.hashOffset, sizeof(Hash));
+    memcpy((void*)&growth, base + header.growthOffset, sizeof(Growth));
+    slots = reinterpret_cast<const MappedSlot<T>*>(base + header.slotsOffset);
+    arena = base + header.arenaOffset;
+    arenaSize = header.arenaSize;
+
+    // probes stay in [0, growth.size())
+    if (growth.size() != m)
+        close();
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+MappedHashtable<T, Hash, Probe, Key, Growth>::MappedHashtable(MappedHashtable&& other)
+        : base(other.base), length(other.length), m(other.m), itemsInTable(other.itemsInTable),
+          hasher(other.hasher), growth(other.growth), slots(other.slots), arena(other.arena),
+          arenaSize(other.arenaSize), garbage() {
+    other.base = nullptr;
+    other.length = 0;
+    other.m = 0;
+    other.slots = nullptr;
+}
+
+// destructor
+template<class T, class Hash, class Probe, class Key, class Growth>
+MappedHashtable<T, Hash, Probe, Key, Growth>::~MappedHashtable() {
+    close();
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+const T& MappedHashtable<T, Hash, Probe, Key, Growth>::lookup(View k) const {
+    if (m == 0)
+        return garbage;
+
+    std::string_view bytes = mappedBytes(k);
+    int hashNum = growth.reduce(hasher(k));
+
+    // probe
+    int newHash = hashNum;
+    int probeCount = 0;
+    while (slots[newHash].home >= 0) {
+        const MappedSlot<T>& slot = slots[newHash];
+        if (MappedHeader::fits(slot.keyOffset, slot.keyLength, arenaSize)
+                && std::string_view(arena + slot.keyOffset, slot.keyLength) == bytes)
+            return slot.val;
+        if constexpr (Probe::robinHood) {
+            if (Probe::distance(slot.home, newHash, m) < probeCount)
+                break;
+        }
+        if (++probeCount == m)
+            break;
+        newHash = Probe::next(hashNum, probeCount, growth);
+    }
+
+    return garbage;
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+void MappedHashtable<T, Hash, Probe, Key, Growth>::close() {
+    if (base != nullptr)
+        munmap(base, length);
+    base = nullptr;
+    length = 0;
+    m = 0;
+    slots = nullptr;
+}
+
+#endif
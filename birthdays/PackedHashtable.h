@@ -0,0 +1,301 @@
+#ifndef PACKEDHASHTABLE_H
+#define PACKEDHASHTABLE_H
+
+#include "HashPolicies.h"
+#include "KeyArena.h"
+#include "UniversalHash.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Compact table for small values, e.g. sets and counters. Each slot is
+ * one 64-bit word: a 32-bit fingerprint of the key's hash on top and
+ * the value's bytes below, 0 meaning empty. The keys live in a side
+ * array at the same index, and std::string keys keep their bytes in a
+ * KeyArena, so a probe walks 8 slots per cache line and only reads a
+ * key when its fingerprint matches.
+ *
+ * Slots are linear probed over a power of two size, with the home slot
+ * from the low bits of the mixed hash and the fingerprint from the high
+ * bits. Values must be trivially copyable and at most 4 bytes.
+ *
+ * A key is only stored once: add keeps the value of a key that's
+ * already there, so lookup finds the same value Hashtable's does, and
+ * insertOrAssign overwrites it. lookup returns the value rather than a
+ * reference to it, since it's packed.
+ * increment adds to a key's value (adding the key first if it's
+ * missing) in one probe, for counting.
+ */
+template<class T, class Hash = UniversalHash, class Key = std::string>
+class PackedHashtable {
+public:
+    typedef typename KeyTraits<Key>::View View;
+
+    PackedHashtable(bool debug = false, unsigned int size = 16);
+    PackedHashtable(const PackedHashtable&) = delete;
+    PackedHashtable& operator=(const PackedHashtable&) = delete;
+    ~PackedHashtable();
+    template<class K>
+    int add(K&& k, const T& val);
+    template<class K>
+    bool insertOrAssign(K&& k, const T& val);
+    template<class K>
+    T increment(K&& k, T by = 1);
+    T lookup(View k) const;
+    bool contains(View k) const;
+    void reportAll(std::ostream& out) const;
+    void resize();
+    uint64_t hash(View k) const;
+    int items() const { return itemsInTable; }
+    size_t bytes() const;
+
+private:
+    static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= 4,
+            "packed values must be trivially copyable and at most 4 bytes");
+
+    // string keys are kept as views of the arena
+    static const bool arenaKeys = KeyTraits<Key>::arena || std::is_same<Key, std::string>::value;
+    typedef typename std::conditional<arenaKeys, ArenaString, Key>::type Stored;
+
+    static uint64_t fingerprint(uint64_t h);
+    static uint64_t pack(uint64_t fp, const T& val);
+    static T unpack(uint64_t slot);
+    int find(View k, uint64_t h) const;
+    template<class K>
+    int claim(K&& k, uint64_t h, int* probes);
+    void grow();
+
+    bool debug;
+    int m;
+    uint64_t mask;
+    int itemsInTable;
+    Hash hasher;
+    uint64_t* slots;
+    Stored* keys;
+    KeyArena keyArena;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<class T, class Hash, class Key>
+PackedHashtable<T, Hash, Key>::PackedHashtable(bool debug, unsigned int size) {
+    this->debug = debug;
+
+    // round up to a power of two
+    m = 16;
+    while ((unsigned int)m < size)
+        m *= 2;
+    mask = m - 1;
+    itemsInTable = 0;
+
+    slots = new uint64_t[m];
+    memset(slots, 0, sizeof(uint64_t) * m);
+    keys = static_cast<Stored*>(::operator new(sizeof(Stored) * m));
+
+    // init r; the slot and fingerprint come from the mixed hash
+    hasher = Hash(debug, largestIntPrime);
+}
+
+// destructor
+template<class T, class Hash, class Key>
+PackedHashtable<T, Hash, Key>::~PackedHashtable() {
+    // dealloc
+    for (int i = 0; i < m; ++i)
+        if (slots[i] != 0)
+            keys[i].~Stored();
+    ::operator delete(keys);
+    delete[] slots;
+}
+
+// returns how far from its home slot the item landed, 0 if k was
+// already there, whatever its value
+template<class T, class Hash, class Key>
+template<class K>
+int PackedHashtable<T, Hash, Key>::add(K&& k, const T& val) {
+    View view = k;
+    uint64_t h = hash(view);
+    if (find(view, h) >= 0)
+        return 0;
+
+    int probes = 0;
+    int slot = claim(std::forward<K>(k), h, &probes);
+    slots[slot] = pack(fingerprint(h), val);
+    grow();
+    return probes;
+}
+
+// adds k with val, or overwrites k's value; returns whether k was added
+template<class T, class Hash, class Key>
+template<class K>
+bool PackedHashtable<T, Hash, Key>::insertOrAssign(K&& k, const T& val) {
+    View view = k;
+    uint64_t h = hash(view);
+    int slot = find(view, h);
+    bool inserted = slot < 0;
+    if (inserted)
+        slot = claim(std::forward<K>(k), h, nullptr);
+
+    slots[slot] = pack(fingerprint(h), val);
+    if (inserted)
+        grow();
+    return inserted;
+}
+
+// adds by to k's value, k starting out at T() if it's missing; returns
+// the new value
+template<class T, class Hash, class Key>
+template<class K>
+T PackedHashtable<T, Hash, Key>::increment(K&& k, T by) {
+    View view = k;
+    uint64_t h = hash(view);
+    int slot = find(view, h);
+    bool inserted = slot < 0;
+    if (inserted)
+        slot = claim(std::forward<K>(k), h, nullptr);
+
+    T val = inserted ? T() + by : unpack(slots[slot]) + by;
+    slots[slot] = pack(fingerprint(h), val);
+    if (inserted)
+        grow();
+    return val;
+}
+
+// k's value, or T() if it's missing
+template<class T, class Hash, class Key>
+T PackedHashtable<T, Hash, Key>::lookup(View k) const {
+    int slot = find(k, hash(k));
+    return slot >= 0 ? unpack(slots[slot]) : T();
+}
+
+template<class T, class Hash, class Key>
+bool PackedHashtable<T, Hash, Key>::contains(View k) const {
+    return find(k, hash(k)) >= 0;
+}
+
+template<class T, class Hash, class Key>
+void PackedHashtable<T, Hash, Key>::reportAll(std::ostream& out) const {
+    for (int i = 0; i < m; ++i) {
+        if (slots[i] != 0)
+            out << keys[i] << ' ' << unpack(slots[i]) << std::endl;
+    }
+}
+
+template<class T, class Hash, class Key>
+void PackedHashtable<T, Hash, Key>::resize() {
+    int oldSize = m;
+    uint64_t* oldSlots = slots;
+    Stored* oldKeys = keys;
+
+    // new table, swap tables
+    m *= 2;
+    mask = m - 1;
+    slots = new uint64_t[m];
+    memset(slots, 0, sizeof(uint64_t) * m);
+    keys = static_cast<Stored*>(::operator new(sizeof(Stored) * m));
+
+    // re-hash; the fingerprint stays the same, only the home moves
+    for (int i = 0; i < oldSize; ++i)
+        if (oldSlots[i] != 0) {
+            int slot = hash(oldKeys[i]) & mask;
+            while (slots[slot] != 0)
+                slot = (slot + 1) & mask;
+            slots[slot] = oldSlots[i];
+            new (&keys[slot]) Stored(std::move(oldKeys[i]));
+            oldKeys[i].~Stored();
+        }
+
+    // dealloc
+    ::operator delete(oldKeys);
+    delete[] oldSlots;
+}
+
+template<class T, class Hash, class Key>
+uint64_t PackedHashtable<T, Hash, Key>::hash(View k) const {
+    return mix64(hasher(k));
+}
+
+// bytes held by the slots, the key array and the key arena
+template<class T, class Hash, class Key>
+size_t PackedHashtable<T, Hash, Key>::bytes() const {
+    return (sizeof(uint64_t) + sizeof(Stored)) * m + keyArena.bytes();
+}
+
+// the top 32 bits of the hash, never 0
+template<class T, class Hash, class Key>
+uint64_t PackedHashtable<T, Hash, Key>::fingerprint(uint64_t h) {
+    uint64_t fp = h >> 32;
+    return fp != 0 ? fp : 1;
+}
+
+template<class T, class Hash, class Key>
+uint64_t PackedHashtable<T, Hash, Key>::pack(uint64_t fp, const T& val) {
+    uint32_t bits = 0;
+    memcpy(&bits, &val, sizeof(T));
+    return fp << 32 | bits;
+}
+
+template<class T, class Hash, class Key>
+T PackedHashtable<T, Hash, Key>::unpack(uint64_t slot) {
+    uint32_t bits = slot;
+    T val;
+    memcpy(&val, &bits, sizeof(T));
+    return val;
+}
+
+// k's slot, or -1; keys are only compared when the fingerprint matches
+template<class T, class Hash, class Key>
+int PackedHashtable<T, Hash, Key>::find(View k, uint64_t h) const {
+    uint64_t fp = fingerprint(h);
+    int slot = h & mask;
+    while (slots[slot] != 0) {
+        if (slots[slot] >> 32 == fp && KeyTraits<Stored>::equal(keys[slot], k))
+            return slot;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+// stores k in the first empty slot from its home and returns the slot,
+// adding how far that was to probes if given; the caller fills in the
+// slot word
+template<class T, class Hash, class Key>
+template<class K>
+int PackedHashtable<T, Hash, Key>::claim(K&& k, uint64_t h, int* probes) {
+    int slot = h & mask;
+    int probeCount = 0;
+    while (slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+        ++probeCount;
+    }
+
+    if constexpr (arenaKeys)
+        new (&keys[slot]) Stored(keyArena.store(View(k)));
+    else
+        new (&keys[slot]) Stored(std::forward<K>(k));
+    ++itemsInTable;
+
+    if (probes != nullptr)
+        *probes = probeCount;
+    return slot;
+}
+
+// grows once 3/4 of the slots are in use; linear probes get long past that
+template<class T, class Hash, class Key>
+void PackedHashtable<T, Hash, Key>::grow() {
+    if (4 * itemsInTable > 3 * m)
+        resize();
+}
+
+#endif
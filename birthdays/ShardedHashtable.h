@@ -0,0 +1,192 @@
+#ifndef SHARDEDHASHTABLE_H
+#define SHARDEDHASHTABLE_H
+
+#include "HashPolicies.h"
+#include "Hashtable.h"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * A set of independent Hashtables for building a big table in
+ * parallel. Each key belongs to one shard, picked by the top bits of
+ * its (mixed) hash.
+ *
+ * Loading happens in two steps. Every loading thread gets its own
+ * Inserter, which just buffers pairs per shard, so adds never write to
+ * memory another thread is using. merge then builds the shards from
+ * those buffers, one thread per shard at a time. After a merge, lookup
+ * goes straight to the key's shard, and any number of threads can look
+ * up at once, with -DHASHTABLE_STATS too. Keys added after a merge show
+ * up at the next one.
+ */
+template<class T, class Hash = UniversalHash, class Probe = QuadraticProbe, class Key = std::string,
+        class Growth = PrimeGrowth>
+class ShardedHashtable {
+public:
+    typedef typename KeyTraits<Key>::View View;
+    typedef Hashtable<T, Hash, Probe, Key, Growth> Shard;
+
+    class Inserter;
+
+    ShardedHashtable(bool debug = false, int shardBits = 6);
+    ~ShardedHashtable();
+    Inserter inserter();
+    void merge(int threads = std::thread::hardware_concurrency());
+    const T& lookup(View k);
+    void reportAll(std::ostream& out) const;
+    int shardOf(View k) const;
+    int shardCount() const { return shards; }
+
+private:
+    // arena keys only point at the caller's bytes, so they're buffered
+    // as strings until the shard copies them into its arena
+    typedef typename std::conditional<KeyTraits<Key>::arena, std::string, Key>::type Pending;
+
+    // one loading thread's pairs, bucketed by shard
+    struct alignas(64) Buffer {
+        std::vector<std::pair<Pending, T>>* pending;
+    };
+
+    bool debug;
+    int shardBits;
+    int shards;
+    Hash router;
+    Shard** table;
+    std::mutex buffersLock;
+    std::vector<Buffer*> buffers;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// a loading thread's handle; only that thread should use it
+template<class T, class Hash, class Probe, class Key, class Growth>
+class ShardedHashtable<T, Hash, Probe, Key, Growth>::Inserter {
+public:
+    template<class K>
+    void add(K&& k, const T& val);
+
+private:
+    friend class ShardedHashtable;
+    Inserter(const ShardedHashtable& owner, Buffer* buffer) : owner(owner), buffer(buffer) {}
+
+    const ShardedHashtable& owner;
+    Buffer* buffer;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+template<class K>
+void ShardedHashtable<T, Hash, Probe, Key, Growth>::Inserter::add(K&& k, const T& val) {
+    int s = owner.shardOf(k);
+    buffer->pending[s].emplace_back(std::forward<K>(k), val);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<class T, class Hash, class Probe, class Key, class Growth>
+ShardedHashtable<T, Hash, Probe, Key, Growth>::ShardedHashtable(bool debug, int shardBits) {
+    this->debug = debug;
+    this->shardBits = shardBits;
+    shards = 1 << shardBits;
+
+    table = new Shard*[shards];
+    for (int i = 0; i < shards; ++i)
+        table[i] = new Shard(debug);
+
+    // the router's hash is independent of the shards' slot hashes
+    router = Hash(debug, largestIntPrime);
+}
+
+// destructor
+template<class T, class Hash, class Probe, class Key, class Growth>
+ShardedHashtable<T, Hash, Probe, Key, Growth>::~ShardedHashtable() {
+    // dealloc
+    for (int i = 0; i < shards; ++i)
+        delete table[i];
+    delete[] table;
+
+    for (Buffer* buffer : buffers) {
+        delete[] buffer->pending;
+        delete buffer;
+    }
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+typename ShardedHashtable<T, Hash, Probe, Key, Growth>::Inserter ShardedHashtable<T, Hash, Probe, Key, Growth>::inserter() {
+    Buffer* buffer = new Buffer;
+    buffer->pending = new std::vector<std::pair<Pending, T>>[shards];
+
+    std::lock_guard<std::mutex> hold(buffersLock);
+    buffers.push_back(buffer);
+    return Inserter(*this, buffer);
+}
+
+// moves every buffered pair into its shard. Shards are handed out to
+// the threads one at a time, so no two threads touch the same shard.
+// No Inserter may add while a merge is running
+template<class T, class Hash, class Probe, class Key, class Growth>
+void ShardedHashtable<T, Hash, Probe, Key, Growth>::merge(int threads) {
+    if (threads < 1)
+        threads = 1;
+    if (threads > shards)
+        threads = shards;
+
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        int s;
+        while ((s = next++) < shards) {
+            for (Buffer* buffer : buffers) {
+                for (std::pair<Pending, T>& kv : buffer->pending[s])
+                    table[s]->add(std::move(kv.first), std::move(kv.second));
+                // let go of the memory, not just the items
+                std::vector<std::pair<Pending, T>>().swap(buffer->pending[s]);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i)
+        workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+const T& ShardedHashtable<T, Hash, Probe, Key, Growth>::lookup(View k) {
+    return table[shardOf(k)]->lookup(k);
+}
+
+template<class T, class Hash, class Probe, class Key, class Growth>
+void ShardedHashtable<T, Hash, Probe, Key, Growth>::reportAll(std::ostream& out) const {
+    for (int i = 0; i < shards; ++i)
+        table[i]->reportAll(out);
+}
+
+// the top shardBits bits of the mixed hash, so the shards' own hashes
+// (which use the low bits) stay independent of the routing
+template<class T, class Hash, class Probe, class Key, class Growth>
+int ShardedHashtable<T, Hash, Probe, Key, Growth>::shardOf(View k) const {
+    if (shardBits == 0)
+        return 0;
+    return mix64(router(k)) >> (64 - shardBits);
+}
+
+#endif
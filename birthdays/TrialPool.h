@@ -0,0 +1,132 @@
+#ifndef TRIALPOOL_H
+#define TRIALPOOL_H
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Runs trials 0 to n - 1 on a set of threads with work stealing. Every
+ * worker starts with an even share of the trials and takes them from
+ * the front of its share, chunk at a time. A worker that runs dry
+ * steals the back half of the biggest share left, so slow trials on
+ * one thread don't leave the others idle at the end.
+ *
+ * run(n, fn) calls fn(worker, lo, hi) for each chunk [lo, hi) and
+ * returns once every trial has run. worker is in [0, threads()), so
+ * callers can keep per-worker state (a table, counters) without
+ * locking.
+ */
+class TrialPool {
+public:
+    TrialPool(int threads = std::thread::hardware_concurrency());
+    template<class Fn>
+    void run(long long n, Fn fn);
+    int threads() const { return workers; }
+
+private:
+    // one worker's share, [lo, hi)
+    struct alignas(64) Share {
+        std::mutex lock;
+        long long lo;
+        long long hi;
+    };
+
+    static const long long chunk = 1024;
+
+    bool take(Share& own, long long& lo, long long& hi);
+    bool steal(int worker, Share* shares);
+
+    int workers;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+inline TrialPool::TrialPool(int threads) {
+    workers = threads > 0 ? threads : 1;
+}
+
+template<class Fn>
+void TrialPool::run(long long n, Fn fn) {
+    Share* shares = new Share[workers];
+    for (int w = 0; w < workers; ++w) {
+        shares[w].lo = n * w / workers;
+        shares[w].hi = n * (w + 1) / workers;
+    }
+
+    auto work = [&](int w) {
+        long long lo, hi;
+        while (true) {
+            if (take(shares[w], lo, hi))
+                fn(w, lo, hi);
+            else if (!steal(w, shares))
+                break;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < workers; ++w)
+        threads.emplace_back(work, w);
+    work(0);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    // dealloc
+    delete[] shares;
+}
+
+// the next chunk from the front of own, if there is one
+inline bool TrialPool::take(Share& own, long long& lo, long long& hi) {
+    std::lock_guard<std::mutex> hold(own.lock);
+    if (own.lo >= own.hi)
+        return false;
+    lo = own.lo;
+    hi = own.lo + chunk < own.hi ? own.lo + chunk : own.hi;
+    own.lo = hi;
+    return true;
+}
+
+// moves the back half of the biggest other share into worker's own;
+// false once every share is empty. Only one lock is held at a time
+inline bool TrialPool::steal(int worker, Share* shares) {
+    while (true) {
+        int victim = -1;
+        long long most = 0;
+        for (int w = 0; w < workers; ++w) {
+            if (w == worker)
+                continue;
+            std::lock_guard<std::mutex> hold(shares[w].lock);
+            if (shares[w].hi - shares[w].lo > most) {
+                most = shares[w].hi - shares[w].lo;
+                victim = w;
+            }
+        }
+        if (victim < 0)
+            return false;
+
+        long long lo, hi;
+        {
+            std::lock_guard<std::mutex> hold(shares[victim].lock);
+            // someone else may have got there first
+            if (shares[victim].lo >= shares[victim].hi)
+                continue;
+            hi = shares[victim].hi;
+            lo = shares[victim].lo + (hi - shares[victim].lo) / 2;
+            shares[victim].hi = lo;
+        }
+
+        std::lock_guard<std::mutex> hold(shares[worker].lock);
+        shares[worker].lo = lo;
+        shares[worker].hi = hi;
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef TRIALSTATS_H
+#define TRIALSTATS_H
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * Statistics of trial counts, kept as the trials finish, in constant
+ * memory however many there are. Counts are small integers, so the sum
+ * and the sum of squares are kept exactly, and the mean and variance
+ * come from them. Every count from 0 to MaxCount gets its own bin,
+ * so the histogram, the CDF and the percentiles are exact; anything
+ * above MaxCount lands in the last bin. Negative counts (a trial that
+ * gave up) are only counted, as failures.
+ *
+ * Each thread can keep its own and merge them at the end. Merging just
+ * adds everything up, so the result is exactly the same however the
+ * counts were split between accumulators or in what order they merged.
+ */
+template<int MaxCount>
+class TrialStats {
+public:
+    TrialStats();
+    void add(int count);
+    void merge(const TrialStats& other);
+    long long trials() const { return n; }
+    long long failures() const { return failed; }
+    double mean() const { return n > 0 ? (double)sum / n : 0; }
+    double variance() const;
+    double stddev() const { return std::sqrt(variance()); }
+    int min() const;
+    int max() const;
+    long long atMost(int count) const;
+    double cdf(int count) const;
+    int percentile(double p) const;
+    void report(std::ostream& out) const;
+
+private:
+    static_assert(MaxCount > 0, "need at least one bin past 0");
+
+    long long n;
+    long long failed;
+    long long sum;
+    long long sumSquares;
+    long long bins[MaxCount + 1];
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+template<int MaxCount>
+TrialStats<MaxCount>::TrialStats() : n(0), failed(0), sum(0), sumSquares(0), bins() {}
+
+template<int MaxCount>
+void TrialStats<MaxCount>::add(int count) {
+    if (count < 0) {
+        ++failed;
+        return;
+    }
+    ++n;
+    sum += count;
+    sumSquares += (long long)count * count;
+    ++bins[count < MaxCount ? count : MaxCount];
+}
+
+template<int MaxCount>
+void TrialStats<MaxCount>::merge(const TrialStats& other) {
+    n += other.n;
+    failed += other.failed;
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+    for (int i = 0; i <= MaxCount; ++i)
+        bins[i] += other.bins[i];
+}
+
+// the sample variance, worked out exactly before the one divide
+template<int MaxCount>
+double TrialStats<MaxCount>::variance() const {
+    if (n < 2)
+        return 0;
+    __int128 spread = (__int128)n * sumSquares - (__int128)sum * sum;
+    return (double)spread / ((double)n * (n - 1));
+}
+
+// smallest count seen, or -1 with no trials; so is max
+template<int MaxCount>
+int TrialStats<MaxCount>::min() const {
+    for (int i = 0; i <= MaxCount; ++i)
+        if (bins[i] > 0)
+            return i;
+    return -1;
+}
+
+template<int MaxCount>
+int TrialStats<MaxCount>::max() const {
+    for (int i = MaxCount; i >= 0; --i)
+        if (bins[i] > 0)
+            return i;
+    return -1;
+}
+
+// trials that finished in count or less
+template<int MaxCount>
+long long TrialStats<MaxCount>::atMost(int count) const {
+    long long total = 0;
+    for (int i = 0; i <= count && i <= MaxCount; ++i)
+        total += bins[i];
+    return total;
+}
+
+template<int MaxCount>
+double TrialStats<MaxCount>::cdf(int count) const {
+    return n > 0 ? (double)atMost(count) / n : 0;
+}
+
+// the smallest count at least a fraction p of the trials finished in
+template<int MaxCount>
+int TrialStats<MaxCount>::percentile(double p) const {
+    long long total = 0;
+    for (int i = 0; i <= MaxCount; ++i) {
+        total += bins[i];
+        if (total > 0 && total >= p * n)
+            return i;
+    }
+    return -1;
+}
+
+// the moments, some percentiles, then every count seen with how many
+// trials finished in it and the CDF up to it
+template<int MaxCount>
+void TrialStats<MaxCount>::report(std::ostream& out) const {
+    static const double marks[] = {0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99};
+
+    // nothing to take a min, max or percentile of
+    if (n == 0) {
+        out << "No trials to report." << std::endl;
+        return;
+    }
+
+    out << "Mean " << mean() << ", standard deviation " << stddev();
+    out << ", min " << min() << ", max " << max() << std::endl;
+    out << "Percentiles:";
+    for (double p : marks)
+        out << ' ' << p * 100 << "%=" << percentile(p);
+    out << std::endl;
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::setw(8) << "count" << std::setw(14) << "trials" << std::setw(12) << "cdf" << std::endl;
+    out << std::fixed;
+    long long total = 0;
+    for (int i = 0; i <= MaxCount; ++i) {
+        if (bins[i] == 0)
+            continue;
+        total += bins[i];
+        out << std::setw(8) << i << (i == MaxCount ? "+" : " ") << std::setw(13) << bins[i];
+        out << std::setw(12) << (double)total / n << std::endl;
+    }
+    out.flags(flags);
+}
+
+#endif
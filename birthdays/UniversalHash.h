@@ -0,0 +1,217 @@
+#ifndef UNIVERSALHASH_H
+#define UNIVERSALHASH_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// a modulus for tables that take the slot from a mixed hash rather than
+// the hash mod their size: the largest prime that fits in an int
+const int largestIntPrime = 2147483647;
+
+// a new random number for a hash's seeds. Every hash draws from one
+// splitmix64 sequence, started from the time unless seedHashes picks
+// where it starts, so tables made together still get different seeds.
+// Any thread can draw
+uint64_t hashSeed();
+void seedHashes(uint64_t seed);
+
+/**
+ * The universal hash Hashtable has always used: the last 30 letters of
+ * the key are split into 5 base-27 words w, and the hash is
+ * (r[0]w[0] + ... + r[4]w[4]) % m. operator() returns a non-negative
+ * value congruent to that sum mod m and leaves the final reduction to
+ * the table's growth policy.
+ *
+ * Every letter's weight r[i] * 27^j is folded into one precomputed
+ * coefficient (reduced mod m) whenever r or m change, so hashing a key
+ * is a single dot product with no pow calls or branches per letter.
+ * Keys of 30 or more letters are read with two 16-byte loads and the
+ * dot product is done in AVX2 registers when available.
+ *
+ * Results match the original loop exactly for lowercase keys, so a
+ * debug table still hashes reproducibly with r_default.
+ *
+ * Integer keys are hashed the same way, with the key's base-27 digits
+ * standing in for its letters.
+ */
+class UniversalHash {
+public:
+    UniversalHash(bool debug = false, int m = 11);
+    void reseed(int m);
+    unsigned long long operator()(std::string_view k) const;
+    unsigned long long operator()(long long k) const;
+    template<size_t N>
+    unsigned long long operator()(const std::array<char, N>& k) const;
+    template<class K>
+    void hashMany(const K* keys, int n, unsigned long long* out) const;
+
+    static const int r_default[5];
+
+private:
+    void buildTables();
+    unsigned long long fold(long long x) const;
+
+    bool debug;
+    int m;
+    int r[5];
+    // coef[p] is the weight of the letter p places from the end
+    uint32_t coef[30];
+    // coefficients in the order the two loads lay out the last 30 letters
+    alignas(32) uint32_t lanes[32];
+    // 96 * (weights of the last len letters), to undo the 'a' - 1 offset
+    long long bias[31];
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+inline std::atomic<uint64_t>& hashSeedState() {
+    static std::atomic<uint64_t> state(std::time(nullptr));
+    return state;
+}
+
+inline uint64_t hashSeed() {
+    uint64_t z = hashSeedState().fetch_add(0x9e3779b97f4a7c15, std::memory_order_relaxed) + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+inline void seedHashes(uint64_t seed) {
+    hashSeedState().store(seed, std::memory_order_relaxed);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+inline const int UniversalHash::r_default[5] = {983132572, 1468777056, 552714139, 984953261, 261934300};
+
+// constructor
+inline UniversalHash::UniversalHash(bool debug, int m) {
+    this->debug = debug;
+    for (int i = 0; i < 5; ++i)
+        r[i] = r_default[i];
+    reseed(m);
+}
+
+// picks new r values (unless debugging) for a table of size m
+inline void UniversalHash::reseed(int m) {
+    this->m = m;
+    if (!debug)
+        for (int i = 0; i < 5; ++i)
+            r[i] = hashSeed() % m;
+    buildTables();
+}
+
+inline unsigned long long UniversalHash::operator()(std::string_view k) const {
+    int len = k.size();
+    const unsigned char* s = (const unsigned char*)k.data();
+
+    long long sum = 0;
+    if (len >= 30) {
+        s += len - 30;
+#if defined(__AVX2__)
+        // letters 0-15 and 14-29 of the window; lanes[16] and lanes[17]
+        // are 0 so the two overlapping letters only count once
+        __m128i lo = _mm_loadu_si128((const __m128i*)s);
+        __m128i hi = _mm_loadu_si128((const __m128i*)(s + 14));
+        __m128i chunk[4] = {lo, _mm_srli_si128(lo, 8), hi, _mm_srli_si128(hi, 8)};
+        __m256i acc = _mm256_setzero_si256();
+        for (int q = 0; q < 4; ++q) {
+            __m256i x = _mm256_cvtepu8_epi32(chunk[q]);
+            __m256i c = _mm256_load_si256((const __m256i*)(lanes + 8 * q));
+            acc = _mm256_add_epi64(acc, _mm256_mul_epu32(x, c));
+            acc = _mm256_add_epi64(acc, _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(c, 32)));
+        }
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        sum = _mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1);
+#else
+        for (int p = 0; p < 30; ++p)
+            sum += (long long)coef[p] * s[29 - p];
+#endif
+        sum -= bias[30];
+    } else {
+        for (int p = 0; p < len; ++p)
+            sum += (long long)coef[p] * s[len - 1 - p];
+        sum -= bias[len];
+    }
+
+    return fold(sum);
+}
+
+inline unsigned long long UniversalHash::operator()(long long k) const {
+    // 14 base-27 digits cover every 64-bit value
+    unsigned long long digits = k;
+    long long sum = 0;
+    for (int p = 0; p < 14; ++p) {
+        sum += (long long)coef[p] * (long long)(digits % 27);
+        digits /= 27;
+    }
+    return fold(sum);
+}
+
+// fixed width keys hash like the string of their letters
+template<size_t N>
+unsigned long long UniversalHash::operator()(const std::array<char, N>& k) const {
+    return (*this)(std::string_view(k.data(), N));
+}
+
+// hashes n keys into out; the keys are independent so their
+// dot products overlap in the pipeline
+template<class K>
+void UniversalHash::hashMany(const K* keys, int n, unsigned long long* out) const {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        unsigned long long h0 = (*this)(keys[i]);
+        unsigned long long h1 = (*this)(keys[i + 1]);
+        unsigned long long h2 = (*this)(keys[i + 2]);
+        unsigned long long h3 = (*this)(keys[i + 3]);
+        out[i] = h0;
+        out[i + 1] = h1;
+        out[i + 2] = h2;
+        out[i + 3] = h3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(keys[i]);
+}
+
+inline void UniversalHash::buildTables() {
+    // 27^j % m
+    long long pow27[6];
+    pow27[0] = 1 % m;
+    for (int j = 1; j < 6; ++j)
+        pow27[j] = pow27[j - 1] * 27 % m;
+
+    bias[0] = 0;
+    for (int p = 0; p < 30; ++p) {
+        long long rm = ((long long)r[4 - p / 6] % m + m) % m;
+        coef[p] = rm * pow27[p % 6] % m;
+        bias[p + 1] = bias[p] + 96LL * coef[p];
+    }
+
+    for (int i = 0; i < 16; ++i)
+        lanes[i] = coef[29 - i];
+    lanes[16] = lanes[17] = 0;
+    for (int i = 18; i < 32; ++i)
+        lanes[i] = coef[29 - (i - 2)];
+}
+
+// the sum is only negative for keys with letters below 'a'
+inline unsigned long long UniversalHash::fold(long long x) const {
+    return x >= 0 ? x : x % m + m;
+}
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef WORDSFILE_H
+#define WORDSFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * A words file (see wordGen) mapped into memory: a count line, then one
+ * record per line, 30 letters followed by the day. Records are read in
+ * place. next() hands out each word as a view into the mapping and
+ * parses its day from the digits after it, so reading a record
+ * allocates and copies nothing.
+ *
+ * Opening makes one pass over the file to count and check the records.
+ * There's no index: records are read in order, from start().
+ *
+ * Check isOpen() after opening; a missing file, or one with a record
+ * that's too short or has no day, leaves it closed.
+ */
+class WordsFile {
+public:
+    static const size_t wordLength = 30;
+
+    WordsFile(const char* path);
+    WordsFile(const WordsFile&) = delete;
+    WordsFile& operator=(const WordsFile&) = delete;
+    ~WordsFile();
+    bool isOpen() const { return base != nullptr; }
+    size_t records() const { return count; }
+    size_t start() const { return first; }
+    size_t next(size_t at, std::string_view& word, int& day) const;
+
+private:
+    void close();
+
+    char* base;
+    size_t length;
+    // records run from offset first to end
+    size_t first;
+    size_t end;
+    size_t count;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor
+inline WordsFile::WordsFile(const char* path) {
+    base = nullptr;
+    length = 0;
+    first = 0;
+    end = 0;
+    count = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        length = st.st_size;
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+            base = static_cast<char*>(p);
+    }
+    ::close(fd);
+    if (base == nullptr)
+        return;
+
+    // skip the count line, and any newline the file ends with
+    const char* nl = static_cast<const char*>(memchr(base, '\n', length));
+    first = nl != nullptr ? nl - base + 1 : length;
+    end = length;
+    while (end > first && base[end - 1] == '\n')
+        --end;
+
+    // count the records, making sure each has a word and a day
+    size_t at = first;
+    while (at < end) {
+        nl = static_cast<const char*>(memchr(base + at, '\n', end - at));
+        size_t stop = nl != nullptr ? nl - base : end;
+        if (stop - at <= wordLength || base[at + wordLength] < '0' || base[at + wordLength] > '9') {
+            close();
+            return;
+        }
+        ++count;
+        at = stop + 1;
+    }
+    if (count == 0)
+        close();
+}
+
+// destructor
+inline WordsFile::~WordsFile() {
+    close();
+}
+
+// reads the record starting at at; returns where the one after it
+// starts, or end after the last one
+inline size_t WordsFile::next(size_t at, std::string_view& word, int& day) const {
+    word = std::string_view(base + at, wordLength);
+    at += wordLength;
+    day = 0;
+    while (at < end && base[at] != '\n')
+        day = 10 * day + (base[at++] - '0');
+    return at < end ? at + 1 : end;
+}
+
+inline void WordsFile::close() {
+    if (base != nullptr)
+        munmap(base, length);
+    base = nullptr;
+    length = 0;
+    count = 0;
+}
+
+#endif
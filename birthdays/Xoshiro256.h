@@ -0,0 +1,69 @@
+#ifndef XOSHIRO256_H
+#define XOSHIRO256_H
+
+#include "HashPolicies.h"
+#include <cstdint>
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~ DECLARE ~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * xoshiro256** (Blackman and Vigna), a small and fast generator with
+ * 256 bits of state. A generator is picked by a seed and a stream
+ * number, e.g. a trial's index: the stream is mixed into the seed and
+ * the state filled from splitmix64. Each stream's numbers depend only
+ * on (seed, stream), never on which thread draws them or in what order.
+ */
+class Xoshiro256 {
+public:
+    Xoshiro256(uint64_t seed, uint64_t stream = 0);
+    uint64_t next();
+    uint64_t below(uint64_t n);
+    uint64_t state(int i) const { return s[i]; }
+    static uint64_t splitmix64(uint64_t& x);
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t s[4];
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~ IMPLEMENT ~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// constructor; mixing the stream (rather than adding it) keeps nearby
+// streams from starting on overlapping splitmix sequences
+inline Xoshiro256::Xoshiro256(uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ mix64(stream + 1);
+    for (int i = 0; i < 4; ++i)
+        s[i] = splitmix64(x);
+}
+
+inline uint64_t Xoshiro256::next() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// a number in [0, n), by multiplying up and keeping the high 64 bits;
+// the bias is under n / 2^64
+inline uint64_t Xoshiro256::below(uint64_t n) {
+    return ((__uint128_t)next() * n) >> 64;
+}
+
+inline uint64_t Xoshiro256::splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+#endif
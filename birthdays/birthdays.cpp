@@ -1,29 +1,96 @@
-#include "Hashtable.h"
-#include <fstream>
+#include "BitsetTrials.h"
+#include "FixedHashtable.h"
+#include "TrialPool.h"
+#include "TrialStats.h"
+#include "WordsFile.h"
+#include "Xoshiro256.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <thread>
 
 using namespace std;
 
-int testCollision(ifstream& in) {
-    Hashtable<int> calendar(false, 365);
+// keys are views of words that stay put for the whole test, so nothing
+// is copied; each worker reuses one calendar for all its tests, so a
+// test never allocates
+typedef FixedHashtable<int, 365, UniversalHash, QuadraticProbe, string_view> Calendar;
 
-    string temp;
-    in >> temp;
+// a test takes at most one more word than the calendar has days
+typedef TrialStats<Calendar::size() + 1> Stats;
 
+// the mapped file's words in order, shared by every test: each test
+// picks up where the last one stopped, so no two tests share a word,
+// and the tests run out once every record has been read
+struct FileWords {
+    FileWords(const WordsFile& file) : file(file), at(file.start()), left(file.records()) {}
+
+    bool next(string_view& word, int& val) {
+        if (left == 0)
+            return false;
+        --left;
+        at = file.next(at, word, val);
+        return true;
+    }
+
+    const WordsFile& file;
+    size_t at;
+    size_t left;
+};
+
+// a test's words made up on the spot, 30 random letters and a day like
+// wordGen writes, from the test's rng. The letters are kept here, so the
+// words stay good for the test
+struct GeneratedWords {
+    static const int maxWords = 1024;
+
+    GeneratedWords(Xoshiro256& rng) : rng(rng), used(0) {}
+
+    bool next(string_view& word, int& val) {
+        if (used == maxWords)
+            return false;
+        char* w = letters[used++];
+        // a letter from each 16 random bits, scaled to [0, 26) by a
+        // multiply; the letters don't depend on each other, so the loop
+        // vectorizes. That's 8 draws where 3 would hold enough bits, but
+        // spreading fewer bits over 30 letters takes chains of
+        // multiplies, which measured more than twice as slow
+        uint64_t bits[8];
+        for (int i = 0; i < 8; ++i)
+            bits[i] = rng.next();
+        uint16_t chunks[32];
+        memcpy(chunks, bits, sizeof(chunks));
+        for (int i = 0; i < 32; ++i)
+            w[i] = 'a' + (char)((chunks[i] * 26u) >> 16);
+        word = string_view(w, 30);
+        val = rng.below(366);
+        return true;
+    }
+
+    Xoshiro256& rng;
+    int used;
+    // 32 letters are made and the last 2 ignored
+    char letters[maxWords][32];
+};
+
+// adds words to the calendar until one lands away from its home slot;
+// returns how many that took, or -1 if the words ran out first
+template<class Words>
+int testCollision(Words& words, Calendar& calendar) {
+    calendar.clear();
+
+    string_view word;
+    int val;
     int count = 0;
     int probes = 0;
-    string k;
-    int val;
     while (probes < 1) {
-        in >> k;
-        temp = k.substr(30);
-        val = stoi(temp);
-        k = k.substr(0, 30);
-        if (!in.good())
+        if (!words.next(word, val))
             return -1;
-        //cout << "K: " << k << " VAL: " << val << endl;
-        probes = calendar.add(k, val);
+        probes = calendar.add(word, val);
         ++count;
     }
     return count;
@@ -32,46 +99,82 @@ int testCollision(ifstream& in) {
 int main(int argc, char* argv[]) {
 
     if (argc < 3) {
-        cout << "ERROR: Correct format: ./birthdays NUM_TESTS INPUT_FILE" << endl;
+        cout << "ERROR: Correct format: ./birthdays NUM_TESTS INPUT_FILE|-g|-b [THREADS] [SEED]" << endl;
         return 1;
     }
 
-    int numTests = stoi(argv[1]);
+    long long numTests = stoll(argv[1]);
     string inFile = argv[2];
-    ifstream in(inFile);
+    int threads = argc > 3 ? stoi(argv[3]) : thread::hardware_concurrency();
+    uint64_t seed = argc > 4 ? stoull(argv[4]) : time(nullptr);
+
+    // -g makes the words up instead of reading them, and -b skips words
+    // and the calendar and draws days straight into bitsets
+    bool generate = inFile == "-g";
+    bool bitset = inFile == "-b";
+    WordsFile words(generate || bitset ? "" : inFile.c_str());
+    if (!generate && !bitset && !words.isOpen()) {
+        cout << "Error: couldn't read any words from " << inFile << "." << endl;
+        return 1;
+    }
+
+    // every calendar hashes with the same r, drawn from the seed, and
+    // every generated test with its own rng stream, so the results only
+    // depend on the seed and not on the number of threads. Tests reading
+    // the file take its words in turn, which only one thread can do
+    seedHashes(mix64(seed));
+    UniversalHash hasher(false, 365);
+    TrialPool pool(generate || bitset ? threads : 1);
+    FileWords fileWords(words);
 
     cout << "Generating birthdays..." << endl;
+    cout << "Seed " << seed << ", " << pool.threads() << (pool.threads() == 1 ? " thread" : " threads") << endl;
+    Calendar** calendars = new Calendar*[pool.threads()];
+    for (int w = 0; w < pool.threads(); ++w)
+        calendars[w] = new Calendar(hasher);
 
-    int* stats = new int[numTests];
-    int lowVals = 0;
-    for (int i = 0; i < numTests; ++i) {
-        stats[i] = testCollision(in);
-        if (stats[i] == -1) {
-            // error
-            cout << "Error: program ran out of words." << endl;
-            cout << "To run " << numTests << " tests, one would need about ";
-            cout << numTests * 23 << " words." << endl;
-            return 1;
+    // each worker keeps its own stats, merged once the tests are done
+    Stats* stats = new Stats[pool.threads()];
+    pool.run(numTests, [&](int w, long long lo, long long hi) {
+        if (bitset) {
+            BitsetTrials<Calendar::size()> trials(seed);
+            trials.run(lo, hi, [&](long long, int count) { stats[w].add(count); });
+            return;
         }
-        // std::this_thread::sleep_for(std::chrono::seconds(1));
-        if (stats[i] <= 23)
-            ++lowVals;
-    }
-
-    in.close();
+        for (long long i = lo; i < hi; ++i) {
+            if (generate) {
+                Xoshiro256 rng(seed, i);
+                GeneratedWords source(rng);
+                stats[w].add(testCollision(source, *calendars[w]));
+            } else {
+                stats[w].add(testCollision(fileWords, *calendars[w]));
+            }
+        }
+    });
+    Stats total;
+    for (int w = 0; w < pool.threads(); ++w)
+        total.merge(stats[w]);
 
-    long long avg = 0;
-    for (int i = 0; i < numTests; ++i) {
-        avg += stats[i];
+    if (total.failures() > 0) {
+        // error
+        cout << "Error: program ran out of words." << endl;
+        cout << numTests << " tests need more than the " << words.records() << " words in " << inFile << ";";
+        cout << " use a bigger file, fewer tests or -g." << endl;
+        return 1;
     }
-    avg /= numTests;
 
-    cout << "Out of " << numTests << " birthday tests, " << lowVals << " collisions occurred in 23 or less";
-    cout << " (" << (double)lowVals / (double)numTests << "%)." << endl;
-    cout << "Average collision: " << avg << endl;
+    if (total.trials() > 0) {
+        long long lowVals = total.atMost(23);
+        cout << "Out of " << numTests << " birthday tests, " << lowVals << " collisions occurred in 23 or less";
+        cout << " (" << 100 * total.cdf(23) << "%)." << endl;
+    }
+    total.report(cout);
 
     // dealloc
     delete[] stats;
+    for (int w = 0; w < pool.threads(); ++w)
+        delete calendars[w];
+    delete[] calendars;
 
     return 0;
-}
\ No newline at end of file
+}
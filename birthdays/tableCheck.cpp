@@ -0,0 +1,155 @@
+#include "ClockCache.h"
+#include "ConcurrentHashtable.h"
+#include "CuckooHashtable.h"
+#include "FlatHashtable.h"
+#include "Hashtable.h"
+#include "PackedHashtable.h"
+#include "ShardedHashtable.h"
+#include "Xoshiro256.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// checks every table against Hashtable: adding new keys, adding them
+// again, looking them up and looking up keys that were never added
+
+static int failures = 0;
+
+static void check(bool ok, const string& table, const string& what) {
+    if (!ok) {
+        cout << table << ": " << what << " failed" << endl;
+        ++failures;
+    }
+}
+
+// n distinct 30 letter words with values in [0, 366), like words.txt
+static void makeWords(int n, uint64_t seed, vector<string>& words, vector<int>& vals) {
+    Xoshiro256 rng(seed);
+    Hashtable<int> seen;
+    while ((int)words.size() < n) {
+        string word;
+        for (int i = 0; i < 30; ++i)
+            word += (char)('a' + rng.below(26));
+        if (seen.contains(word))
+            continue;
+        seen.add(word, 1);
+        words.push_back(word);
+        vals.push_back(rng.below(366));
+    }
+}
+
+// add, add again, lookup and miss for any table with add and lookup
+template<class Table>
+static void checkTable(Table& table, const string& name, Hashtable<int>& ref, const vector<string>& words,
+        const vector<int>& vals, const vector<string>& missing) {
+    for (size_t i = 0; i < words.size(); ++i)
+        check(table.add(words[i], vals[i]) >= 0, name, "add " + words[i]);
+    for (size_t i = 0; i < words.size(); ++i)
+        check(table.add(words[i], vals[i]) == 0, name, "duplicate " + words[i]);
+    for (const string& word : words)
+        check(table.lookup(word) == ref.lookup(word), name, "lookup " + word);
+    for (const string& word : missing)
+        check(table.lookup(word) == ref.lookup(word), name, "miss " + word);
+}
+
+int main() {
+    const int numWords = 5000;
+
+    vector<string> words, missing;
+    vector<int> vals;
+    makeWords(2 * numWords, 1, words, vals);
+    missing.assign(words.begin() + numWords, words.end());
+    words.resize(numWords);
+    vals.resize(numWords);
+
+    Hashtable<int> ref;
+    for (int i = 0; i < numWords; ++i)
+        ref.add(words[i], vals[i]);
+
+    ConcurrentHashtable<int> concurrent;
+    checkTable(concurrent, "ConcurrentHashtable", ref, words, vals, missing);
+
+    CuckooHashtable<int> cuckoo;
+    checkTable(cuckoo, "CuckooHashtable", ref, words, vals, missing);
+
+    // one key with many values is stored once, with its first value
+    CuckooHashtable<int> sameKey;
+    for (int val = 1; val <= 40; ++val)
+        check(sameKey.add("samekey", val) == 0, "CuckooHashtable", "same key");
+    check(sameKey.lookup("samekey") == 1, "CuckooHashtable", "same key lookup");
+
+    // only the last 30 letters are hashed, so these keys all share two
+    // buckets and the stash; the ones that don't fit are turned away
+    CuckooHashtable<int> sameHash;
+    int stored = 0;
+    for (int i = 0; i < 40; ++i) {
+        string key = to_string(i) + words[0];
+        int moves = sameHash.add(key, i);
+        if (moves >= 0)
+            ++stored;
+        check(sameHash.lookup(key) == (moves >= 0 ? i : 0), "CuckooHashtable", "same hash " + key);
+    }
+    check(stored > 0 && stored < 40, "CuckooHashtable", "same hash stored");
+
+    FlatHashtable<int> flat;
+    checkTable(flat, "FlatHashtable", ref, words, vals, missing);
+
+    // keys too long to keep in the slot go to the arena
+    FlatHashtable<int> flatLong;
+    for (int i = 0; i < 100; ++i)
+        flatLong.add(words[i] + words[i], vals[i]);
+    for (int i = 0; i < 100; ++i) {
+        check(flatLong.lookup(words[i] + words[i]) == vals[i], "FlatHashtable", "long key " + words[i]);
+        check(flatLong.lookup(words[i]) == 0, "FlatHashtable", "long key miss " + words[i]);
+    }
+
+    PackedHashtable<int> packed;
+    checkTable(packed, "PackedHashtable", ref, words, vals, missing);
+    check(packed.items() == numWords, "PackedHashtable", "items");
+
+    // repeated adds of one key leave one item, with the same value as
+    // Hashtable's lookup
+    PackedHashtable<int> repeated;
+    Hashtable<int> repeatedRef;
+    for (int val : {1, 2, 2, 1, 3, 2}) {
+        repeated.add("samekey", val);
+        repeatedRef.add("samekey", val);
+    }
+    check(repeated.items() == 1, "PackedHashtable", "repeated items");
+    check(repeated.lookup("samekey") == repeatedRef.lookup("samekey"), "PackedHashtable", "repeated lookup");
+
+    // the sharded table only has add on its inserters, and only looks
+    // them up after a merge
+    ShardedHashtable<int> sharded(false, 3);
+    ShardedHashtable<int>::Inserter inserter = sharded.inserter();
+    for (int i = 0; i < numWords; ++i)
+        inserter.add(words[i], vals[i]);
+    sharded.merge(2);
+    for (const string& word : words)
+        check(sharded.lookup(word) == ref.lookup(word), "ShardedHashtable", "lookup " + word);
+    for (const string& word : missing)
+        check(sharded.lookup(word) == ref.lookup(word), "ShardedHashtable", "miss " + word);
+
+    // big enough that nothing is evicted; add only reports new keys
+    ClockCache<int> cache(false, numWords);
+    for (int i = 0; i < numWords; ++i)
+        check(cache.add(words[i], vals[i]), "ClockCache", "add " + words[i]);
+    for (int i = 0; i < numWords; ++i)
+        check(!cache.add(words[i], vals[i]), "ClockCache", "duplicate " + words[i]);
+    for (const string& word : words) {
+        const int* val = cache.lookup(word);
+        check(val != nullptr && *val == ref.lookup(word), "ClockCache", "lookup " + word);
+    }
+    for (const string& word : missing)
+        check(cache.lookup(word) == nullptr, "ClockCache", "miss " + word);
+    check(cache.evictions() == 0, "ClockCache", "no evictions");
+
+    if (failures > 0) {
+        cout << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "All tables agree with Hashtable." << endl;
+    return 0;
+}